@@ -4,6 +4,10 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
 
 #include <glm.hpp>
 #include <assimp/cimport.h>
@@ -11,29 +15,53 @@
 #include <assimp/postprocess.h>
 #include <glad/glad.h>
 
+#include "gl_state.hpp"
+#include "mesh_optimizer.hpp"
+#include "quantized_vertex.hpp"
+
 class FBXModel {
 public:
+    // One vertex of the interleaved buffer. Corners that are identical in
+    // every attribute are welded into one vertex and shared through the indices.
+    struct PackedVertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texCoords;
+        uint8_t meshID;             // Assimp mesh the vertex belongs to
+        uint8_t padding[3];         // Zeroed, so vertices compare bytewise
+
+        bool operator==(const PackedVertex& other) const { return std::memcmp(this, &other, sizeof(PackedVertex)) == 0; }
+    };
+
+    // PackedVertex as the GPU reads it; the mesh ID is an integer in the shader
+    using VertexFormat = VertexLayout::Format<
+        VertexLayout::Attribute<0, float, 3>,
+        VertexLayout::Attribute<1, float, 3>,
+        VertexLayout::Attribute<2, float, 2>,
+        VertexLayout::Attribute<3, uint8_t, 1, VertexLayout::kInteger>,
+        VertexLayout::Padding<3>>;
+
     struct ModelData {
-        size_t pointCount = 0;
-        std::vector<glm::vec3> vertices;
-        std::vector<glm::vec3> normals;
-        std::vector<glm::vec2> textureCoords;
-        std::vector<int> meshIDs; // Ϊÿ¼ mesh ID
+        size_t pointCount = 0;              // Triangle corners as imported
+        std::vector<PackedVertex> vertices; // Welded
+        std::vector<uint32_t> indices;      // Three per triangle, into vertices
 
         ModelData() = default;
     };
 
     struct MeshInfo {
-        size_t vertexCount = 0;
+        size_t firstIndex = 0;      // Where the mesh's triangles start in the shared index buffer
+        size_t indexCount = 0;
+        size_t vertexCount = 0;     // Distinct vertices after welding
         bool hasTexture = false;
     };
 
     struct MeshData {
         GLuint vao = 0;
-        GLuint vertexBuffer = 0;
-        GLuint normalBuffer = 0;
-        GLuint textureBuffer = 0;
-        GLuint meshIDBuffer = 0; // ¼ meshID  buffer
+        GLuint vertexBuffer = 0;    // Interleaved PackedVertex
+        GLuint indexBuffer = 0;
+        GLenum indexType = GL_UNSIGNED_INT;     // GL_UNSIGNED_SHORT when the vertices allow
+        size_t indexCount = 0;
         size_t vertexCount = 0;
     };
 
@@ -42,6 +70,13 @@ private:
     std::vector<MeshInfo> meshMeshes; // 洢ÿ mesh Ϣ
 
 public:
+    static_assert(sizeof(PackedVertex) == 36, "PackedVertex must stay tightly packed for the bytewise weld");
+    static_assert(VertexFormat::stride == sizeof(PackedVertex)
+                  && VertexFormat::offsetOf(1) == offsetof(PackedVertex, normal)
+                  && VertexFormat::offsetOf(2) == offsetof(PackedVertex, texCoords)
+                  && VertexFormat::offsetOf(3) == offsetof(PackedVertex, meshID),
+                  "VertexFormat must match PackedVertex");
+
     FBXModel() = default;
 
     bool loadFromFile(const std::string& fileName) {
@@ -55,31 +90,74 @@ public:
             return false;
         }
 
+        struct VertexHash {
+            size_t operator()(const PackedVertex& vertex) const {
+                uint32_t words[sizeof(PackedVertex) / 4];
+                std::memcpy(words, &vertex, sizeof(words));
+                size_t h = 0;
+                for (uint32_t w : words)
+                    h = h * 0x9E3779B1u + w;
+                return h;
+            }
+        };
+        std::unordered_map<PackedVertex, uint32_t, VertexHash> welded;
+        std::vector<PackedVertex> vertices;
+        std::vector<unsigned int> indices;
+        MeshOptimizer::DiskCache optimizerCache(fileName + ".meshopt");
+
         for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
             const aiMesh* mesh = scene->mMeshes[i];
             MeshInfo meshInfo;
-            meshInfo.vertexCount = mesh->mNumVertices;
+            meshInfo.firstIndex = meshData.indices.size();
             meshInfo.hasTexture = mesh->HasTextureCoords(0);
-            meshMeshes.push_back(meshInfo);
 
-            meshData.pointCount += mesh->mNumVertices;
-
-            for (unsigned int v = 0; v < mesh->mNumVertices; ++v) {
-                if (mesh->HasPositions()) {
-                    const aiVector3D* vp = &(mesh->mVertices[v]);
-                    meshData.vertices.push_back(glm::vec3(vp->x, vp->y, vp->z));
-                }
-                if (mesh->HasNormals()) {
-                    const aiVector3D* vn = &(mesh->mNormals[v]);
-                    meshData.normals.push_back(glm::vec3(vn->x, vn->y, vn->z));
-                }
-                if (mesh->HasTextureCoords(0)) {
-                    const aiVector3D* vt = &(mesh->mTextureCoords[0][v]);
-                    meshData.textureCoords.push_back(glm::vec2(vt->x, vt->y));
+            // Vertices of different meshes differ in meshID, so welding is per mesh
+            welded.clear();
+            vertices.clear();
+            indices.clear();
+            for (unsigned int f = 0; f < mesh->mNumFaces; ++f) {
+                const aiFace& face = mesh->mFaces[f];
+                if (face.mNumIndices != 3)
+                    continue;       // Points and lines left over by triangulation
+                for (unsigned int corner = 0; corner < 3; ++corner) {
+                    const unsigned int v = face.mIndices[corner];
+                    PackedVertex vertex;
+                    std::memset(&vertex, 0, sizeof(vertex));
+                    const aiVector3D& vp = mesh->mVertices[v];
+                    vertex.position = glm::vec3(vp.x, vp.y, vp.z);
+                    if (mesh->HasNormals()) {
+                        const aiVector3D& vn = mesh->mNormals[v];
+                        vertex.normal = glm::vec3(vn.x, vn.y, vn.z);
+                    }
+                    if (mesh->HasTextureCoords(0)) {
+                        const aiVector3D& vt = mesh->mTextureCoords[0][v];
+                        vertex.texCoords = glm::vec2(vt.x, vt.y);
+                    }
+                    vertex.meshID = static_cast<uint8_t>(i);
+
+                    const auto inserted = welded.emplace(vertex, static_cast<uint32_t>(vertices.size()));
+                    if (inserted.second)
+                        vertices.push_back(vertex);
+                    indices.push_back(inserted.first->second);
+                    ++meshData.pointCount;
                 }
-                meshData.meshIDs.push_back(i); // ¼ǰ mesh ID
             }
+
+            // Vertex cache, overdraw and vertex fetch order within the mesh
+            const MeshOptimizer::Report report = MeshOptimizer::optimize(vertices, indices,
+                [](const PackedVertex& vertex) { return vertex.position; }, optimizerCache);
+            MeshOptimizer::print(std::cout, fileName, i, report);
+
+            const uint32_t firstVertex = static_cast<uint32_t>(meshData.vertices.size());
+            meshData.vertices.insert(meshData.vertices.end(), vertices.begin(), vertices.end());
+            for (unsigned int index : indices)
+                meshData.indices.push_back(firstVertex + index);
+
+            meshInfo.indexCount = indices.size();
+            meshInfo.vertexCount = vertices.size();
+            meshMeshes.push_back(meshInfo);
         }
+        optimizerCache.save();
 
         aiReleaseImport(scene);
         return true;
@@ -89,47 +167,60 @@ public:
         return meshData;
     }
 
+    // One entry per assimp mesh, in the order of the meshIDs
+    const std::vector<MeshInfo>& getMeshes() const {
+        return meshMeshes;
+    }
+
+    static size_t indexSize(GLenum indexType) {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    // One interleaved vertex buffer and one index buffer, 16-bit when every
+    // vertex can be addressed with it
     void generateObjectBufferMesh(const ModelData& modelData, MeshData& meshData) {
-        meshData.vertexCount = modelData.pointCount;
+        meshData.vertexCount = modelData.vertices.size();
+        meshData.indexCount = modelData.indices.size();
+        meshData.indexType = modelData.vertices.size() <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
-        GLuint buffers[4];
+        GLuint buffers[2];
         glGenVertexArrays(1, &meshData.vao);
-        glGenBuffers(4, buffers);
-
+        glGenBuffers(2, buffers);
         meshData.vertexBuffer = buffers[0];
-        meshData.normalBuffer = buffers[1];
-        meshData.textureBuffer = buffers[2];
-        meshData.meshIDBuffer = buffers[3];
-
-        glBindVertexArray(meshData.vao);
-
-        // λ
-        glBindBuffer(GL_ARRAY_BUFFER, meshData.vertexBuffer);
-        glBufferData(GL_ARRAY_BUFFER, modelData.vertices.size() * sizeof(glm::vec3), modelData.vertices.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-        glEnableVertexAttribArray(0);
-
-        // 
-        glBindBuffer(GL_ARRAY_BUFFER, meshData.normalBuffer);
-        glBufferData(GL_ARRAY_BUFFER, modelData.normals.size() * sizeof(glm::vec3), modelData.normals.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-        glEnableVertexAttribArray(1);
-
-        // ꣨ã
-        if (!modelData.textureCoords.empty()) {
-            glBindBuffer(GL_ARRAY_BUFFER, meshData.textureBuffer);
-            glBufferData(GL_ARRAY_BUFFER, modelData.textureCoords.size() * sizeof(glm::vec2), modelData.textureCoords.data(), GL_STATIC_DRAW);
-            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-            glEnableVertexAttribArray(2);
+        meshData.indexBuffer = buffers[1];
+
+        GlState& gl = GlState::current();
+        gl.bindVertexArray(meshData.vao);
+
+        // Positions are plain floats, so the bounds model.vert applies after them are the identity
+        const size_t vertexBytes = modelData.vertices.size() * sizeof(PackedVertex);
+        const QuantizedVertex::Bounds identity;
+        gl.bindBuffer(GL_ARRAY_BUFFER, meshData.vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes + sizeof(identity), nullptr, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, modelData.vertices.data());
+        glBufferSubData(GL_ARRAY_BUFFER, vertexBytes, sizeof(identity), &identity);
+
+        // The element buffer binding is VAO state
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshData.indexBuffer);
+        if (meshData.indexType == GL_UNSIGNED_SHORT) {
+            const std::vector<uint16_t> indices(modelData.indices.begin(), modelData.indices.end());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
         }
+        else {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, modelData.indices.size() * sizeof(uint32_t), modelData.indices.data(), GL_STATIC_DRAW);
+        }
+
+        VertexFormat::setup();
+        QuantizedVertex::setupBounds(static_cast<GLintptr>(vertexBytes));
 
-        // Mesh ID
-        glBindBuffer(GL_ARRAY_BUFFER, meshData.meshIDBuffer);
-        glBufferData(GL_ARRAY_BUFFER, modelData.meshIDs.size() * sizeof(int), modelData.meshIDs.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(3, 1, GL_INT, 0, 0, nullptr);
-        glEnableVertexAttribArray(3);
+        gl.bindVertexArray(0);
 
-        glBindVertexArray(0);
+        // Before: one position, normal, texture coordinate and int mesh ID per corner
+        const size_t before = modelData.pointCount * (2 * sizeof(glm::vec3) + sizeof(glm::vec2) + sizeof(int));
+        const size_t after = meshData.vertexCount * sizeof(PackedVertex) + meshData.indexCount * indexSize(meshData.indexType);
+        std::cout << "FBX buffers: " << modelData.pointCount << " corners welded into " << meshData.vertexCount
+                  << " vertices, " << before / 1024 << " KiB -> " << after / 1024 << " KiB with "
+                  << (meshData.indexType == GL_UNSIGNED_SHORT ? 16 : 32) << "-bit indices" << std::endl;
     }
 
     void printMeshInfo() const {
@@ -138,11 +229,11 @@ public:
         for (size_t i = 0; i < meshMeshes.size(); ++i) {
             const auto& mesh = meshMeshes[i];
             std::cout << "  Mesh " << i + 1 << ":" << std::endl;
-            std::cout << "    Vertex Count: " << mesh.vertexCount << std::endl;
+            std::cout << "    Triangles: " << mesh.indexCount / 3 << ", Vertices: " << mesh.vertexCount << std::endl;
             std::cout << "    Texture Coordinates: " << (mesh.hasTexture ? "Yes" : "No") << std::endl;
         }
 
-        std::cout << "Total vertices across all meshes: " << meshData.pointCount << std::endl;
+        std::cout << "Total vertices across all meshes: " << meshData.vertices.size() << std::endl;
     }
 };
 
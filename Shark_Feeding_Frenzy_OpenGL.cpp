@@ -9,8 +9,30 @@
 #include "model.hpp"
 #include "FBX.hpp"
 #include "TexFBX.hpp" // Include Texture for Shark texture handling
-
+#include "fish_pool.hpp"
+#include "flock.hpp"
+#include "job_system.hpp"
+#include "simulation.hpp"
+#include "fixed_step.hpp"
+#include "headless.hpp"
+#include "scenario.hpp"
+#include "fish_renderer.hpp"
+#include "streaming_buffer.hpp"
+#include "culling.hpp"
+#include "terrain.hpp"
+#include "lod.hpp"
+#include "impostor.hpp"
+#include "uniform_blocks.hpp"
+#include "gl_state.hpp"
+#include "render_queue.hpp"
+#include "vertex_layout.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <sstream>
 #include <vector>
 
 //// Window Parameters ////
@@ -33,52 +55,164 @@ float quadVertices[] =
      1.0f,  1.0f,  1.0f, 1.0f,
     -1.0f,  1.0f,  0.0f, 1.0f
 };
+using QuadFormat = VertexLayout::Format<VertexLayout::Attribute<0, float, 2>, VertexLayout::Attribute<1, float, 2>>;
+static_assert(QuadFormat::stride * 6 == sizeof(quadVertices), "QuadFormat must match quadVertices");
 
-//// Model parameters ////
-struct Fish 
-{
-    glm::vec3 position;
-    glm::vec3 scale;
-    glm::vec3 rotation;
-    float speed = 0.3f;
-    float angle = 0.0f;
-    float angularSpeed = 0.1f;
-    glm::vec3 center = glm::vec3(0.0f, 0.0f, 0.0f);
-    float radius;
-
-    glm::vec3 boundingSphereCenter;
-    float boundingSphereRadius;
-
-    bool isActive = true; // To see if the fish is alive
-};
+//// Simulation parameters ////
+SimInput simInput;                // Shark controls, sampled once per frame
 
-struct BoundingSphere 
+int main(int argc, char** argv)
 {
-    glm::vec3 center;
-    float radius;
-};
-
-BoundingSphere sharkBoundingSphere1;
-BoundingSphere sharkBoundingSphere2;
+    // --bench-motion [fish]: run the fish motion micro-benchmark and exit
+    // --threads N: job system size (default: hardware concurrency)
+    // --sim-hz N: simulation tick rate (default: 60)
+    // --max-catch-up N: ticks allowed per rendered frame (default: 5)
+    // --headless [--ticks N] [--no-schooling] [--respawn]: simulate without a window and print timings
+    // --seed S, --schools N, --fish-per-school N, --fish M, --size-dist uniform|normal: generated scenario
+    // --extent X Y Z: half size of the box the schools are placed in
+    // --no-instancing: draw the fish one by one (for comparison)
+    // --no-culling: draw everything, skipping the view-frustum tests
+    // --no-lod: draw every instanced fish at full detail
+    // --no-impostors, --impostor-distance D, --impostor-fade W: far fish as impostors from D, crossfading over W
+    unsigned threadCount = 0;
+    double simHz = 60.0;
+    int maxCatchUp = 5;
+    bool headless = false;
+    HeadlessOptions headlessOptions;
+    ScenarioSettings scenario;
+    uint64_t seed = 0;
+    bool seedSet = false;
+    size_t schoolCount = 0, fishPerSchool = 0, fishTotal = 0;
+    float extent[3] = {};
+    bool extentSet = false;
+    const char* sizeDistribution = nullptr;
+    bool instancedFish = true;
+    bool frustumCulling = true;
+    bool fishLod = true;
+    bool fishImpostors = true;
+    float impostorDistance = 30.0f, impostorFade = 6.0f;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--bench-motion") == 0)
+        {
+            size_t fishCount = (i + 1 < argc) ? std::strtoul(argv[i + 1], nullptr, 10) : 1000000;
+            FishMotion::benchmark(fishCount > 0 ? fishCount : 1000000, 100);
+            return 0;
+        }
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threadCount = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        if (std::strcmp(argv[i], "--sim-hz") == 0 && i + 1 < argc)
+        {
+            simHz = std::strtod(argv[++i], nullptr);
+        }
+        if (std::strcmp(argv[i], "--max-catch-up") == 0 && i + 1 < argc)
+        {
+            maxCatchUp = std::atoi(argv[++i]);
+        }
+        if (std::strcmp(argv[i], "--headless") == 0)
+        {
+            headless = true;
+        }
+        if (std::strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+        {
+            headlessOptions.ticks = std::strtoll(argv[++i], nullptr, 10);
+        }
+        if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+            seedSet = true;
+        }
+        if (std::strcmp(argv[i], "--extent") == 0 && i + 3 < argc)
+        {
+            for (float& axis : extent)
+                axis = std::strtof(argv[++i], nullptr);
+            extentSet = true;
+        }
+        if (std::strcmp(argv[i], "--schools") == 0 && i + 1 < argc)
+        {
+            schoolCount = std::strtoul(argv[++i], nullptr, 10);
+        }
+        if (std::strcmp(argv[i], "--fish-per-school") == 0 && i + 1 < argc)
+        {
+            fishPerSchool = std::strtoul(argv[++i], nullptr, 10);
+        }
+        if (std::strcmp(argv[i], "--fish") == 0 && i + 1 < argc)
+        {
+            fishTotal = std::strtoul(argv[++i], nullptr, 10);
+        }
+        if (std::strcmp(argv[i], "--size-dist") == 0 && i + 1 < argc)
+        {
+            sizeDistribution = argv[++i];
+        }
+        if (std::strcmp(argv[i], "--no-instancing") == 0)
+        {
+            instancedFish = false;
+        }
+        if (std::strcmp(argv[i], "--no-culling") == 0)
+        {
+            frustumCulling = false;
+        }
+        if (std::strcmp(argv[i], "--no-lod") == 0)
+        {
+            fishLod = false;
+        }
+        if (std::strcmp(argv[i], "--no-impostors") == 0)
+        {
+            fishImpostors = false;
+        }
+        if (std::strcmp(argv[i], "--impostor-distance") == 0 && i + 1 < argc)
+        {
+            impostorDistance = std::strtof(argv[++i], nullptr);
+        }
+        if (std::strcmp(argv[i], "--impostor-fade") == 0 && i + 1 < argc)
+        {
+            impostorFade = std::strtof(argv[++i], nullptr);
+        }
+        if (std::strcmp(argv[i], "--no-schooling") == 0)
+        {
+            headlessOptions.schooling = false;
+        }
+        if (std::strcmp(argv[i], "--respawn") == 0)
+        {
+            headlessOptions.respawn = true;
+        }
+    }
 
-bool checkCollision(const BoundingSphere& sphere1, const BoundingSphere& sphere2) 
-{
-    float distance = glm::length(sphere1.center - sphere2.center);
-    float radiusSum = sphere1.radius + sphere2.radius;
-    return distance <= radiusSum;
-}
+    // Scenario flags apply to whichever mode runs
+    ScenarioSettings& world = headless ? headlessOptions.scenario : scenario;
+    if (seedSet)
+        world.seed = seed;
+    if (extentSet)
+        world.halfExtent = glm::max(glm::vec3(extent[0], extent[1], extent[2]), glm::vec3(0.0f));
+    if (fishTotal != 0)
+        world.splitFish(fishTotal);
+    if (schoolCount != 0)
+        world.schoolCount = schoolCount;
+    if (fishPerSchool != 0)
+        world.fishPerSchool = fishPerSchool;
+    if (sizeDistribution && std::strcmp(sizeDistribution, "normal") == 0)
+        world.sizeDistribution = SizeDistribution::kNormal;
+    const glm::vec3 fittedExtent = Scenario::fitHalfExtent(world);
+    if (fittedExtent != world.halfExtent)
+    {
+        std::cout << "Scenario: " << world.schoolCount << " schools of radius " << Scenario::schoolRadius(world)
+                  << " do not fit a box of half size " << world.halfExtent.x << " x " << world.halfExtent.y << " x "
+                  << world.halfExtent.z << ", placing them in " << fittedExtent.x << " x " << fittedExtent.y << " x "
+                  << fittedExtent.z << " (see --extent)" << std::endl;
+    }
 
-float sharkDirectionAngle = -60.0f; // Default direction of shark
-float turnSpeed = 10.0f;          // Turning speed
-float sharkPitchAngle = 10.0f;    // Angle of up & down
-float verticalTurnSpeed = 5.0f;   // Up & Down speed
+    JobSystem jobs(threadCount);
 
-float speedBoostTimer = 0.0f;
-bool isSpeedBoostActive = false;
-bool hunted = false;
+    // No GLFW or GL calls on this path, so it runs on machines without a display
+    if (headless)
+    {
+        headlessOptions.tickRate = simHz;
+        runHeadless(headlessOptions, jobs, std::cout);
+        return 0;
+    }
 
-int main() 
-{
     // GLFW initialization
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -103,37 +237,91 @@ int main()
     }
     stbi_set_flip_vertically_on_load(false);
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
+    // All binds and render state go through the cache, which skips redundant calls
+    GlState& gl = GlState::current();
+    gl.enable(GL_DEPTH_TEST);
+    gl.depthFunc(GL_LESS);
 
     // Enable blending for smooth fog transition (fragment alpha blending)
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl.enable(GL_BLEND);
+    gl.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     //// Quad ////
     unsigned int quadVAO, quadVBO;
     glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
+    gl.bindVertexArray(quadVAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    gl.bindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+    QuadFormat::setup();
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-
-    glBindVertexArray(0);
+    gl.bindVertexArray(0);
 
     //// Shaders ////
     Shader backgroundShader("shader/background.vert", "shader/background.frag");
     Shader modelShader("shader/model.vert", "shader/model.frag");
+    Shader fishShader("shader/model_instanced.vert", "shader/model.frag");
+    Shader impostorBakeShader("shader/impostor_bake.vert", "shader/impostor_bake.frag");
+    Shader impostorShader("shader/impostor.vert", "shader/impostor.frag");
+    for (Shader* shader : { &backgroundShader, &modelShader, &fishShader, &impostorBakeShader, &impostorShader })
+        UniformBlocks::bind(*shader);
+
+    // Everything outside the uniform blocks is constant for the run. Uniforms
+    // are program state, so each is set once here; the handles check every
+    // name and type against the linked programs.
+    backgroundShader.use();
+    backgroundShader.uniform<glm::vec3>("sunPosition").set(glm::vec3(0.5f, 0.8f, 0.3f));
+    backgroundShader.uniform<glm::vec3>("topColor").set(glm::vec3(0.0f, 0.3f, 0.5f));
+    backgroundShader.uniform<glm::vec3>("bottomColor").set(glm::vec3(0.0f, 0.1f, 0.2f));
+    for (Shader* shader : { &modelShader, &fishShader })
+    {
+        shader->use();
+        shader->uniform<int>("texture_diffuse").set(0);
+    }
 
     //// Models ////
     Model landModel("model/terrian/ShangGu.obj");
     Model fishModel("model/fish/fish.obj");
+    StreamingBuffer streaming(4 << 20);     // Per-frame uploads: 4 MiB holds ~130k fish instances
+    LodChain fishLods(fishModel);           // Full detail plus 30%, 10% and 3% of the triangles
+    fishLods.print(std::cout, "fish.obj");
+    FishImpostors fishImpostorAtlas(fishModel, impostorBakeShader, streaming, fishModel.textures_loaded[0].id);
+    FishRenderer fishRenderer(fishLods, streaming);
+    fishRenderer.lodEnabled = fishLod;
+    if (fishImpostors)
+    {
+        fishRenderer.impostors = &fishImpostorAtlas;
+        fishRenderer.impostorFadeStart = impostorDistance;
+        fishRenderer.impostorFadeEnd = impostorDistance + std::max(impostorFade, 0.01f);
+    }
+    impostorShader.use();
+    fishImpostorAtlas.configure(impostorShader);
+    gl.useProgram(0);
+
+    // Every shader against the vertex formats it is drawn with
+    const VertexLayout::FormatInfo& bounds = QuantizedVertex::BoundsFormat::info();
+    const VertexLayout::FormatInfo& instances = FishImpostors::InstanceFormat::info();
+    backgroundShader.checkVertexInputs({ QuadFormat::info() }, "the background quad");
+    modelShader.checkVertexInputs({ FBXModel::VertexFormat::info(), bounds }, "shark.fbx");
+    impostorShader.checkVertexInputs({ instances }, "the impostor quads");
+    for (size_t m = 0; m < landModel.meshes.size(); ++m)
+        modelShader.checkVertexInputs({ landModel.meshes[m].vertexFormat(), bounds }, "ShangGu.obj mesh " + std::to_string(m));
+    for (size_t m = 0; m < fishModel.meshes.size(); ++m)
+    {
+        const VertexLayout::FormatInfo& format = fishModel.meshes[m].vertexFormat();
+        const std::string what = "fish.obj mesh " + std::to_string(m);
+        modelShader.checkVertexInputs({ format, bounds }, what);
+        fishShader.checkVertexInputs({ format, bounds, instances }, what);
+        impostorBakeShader.checkVertexInputs({ format, bounds }, what);
+    }
+
+    if (Shader::errorCount() > 0)
+    {
+        std::cerr << "Failed to set up the shaders!" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
 
     FBXModel sharkModel;
     if (!sharkModel.loadFromFile("model/fish/shark.fbx")) 
@@ -146,36 +334,37 @@ int main()
 
     // Shark texture
     TexFBX sharkTexture("model/fish/shark.jpg");
-    glm::vec3 sharkPosition(-10.0f, 2.0f, 10.0f);
-    sharkBoundingSphere1.center = sharkPosition;
-    sharkBoundingSphere1.radius = 12.0f;
 
-    sharkBoundingSphere2.center = sharkPosition;
-    sharkBoundingSphere2.radius = 2.0f;
-
-    float sharkSpeed = 0.4f; // Default shark speed
-
-    // School of fish (10 fishes)
-    std::vector<Fish> fishes =
-    {
-        {{-2.0f, 3.0f, -16.0f}, {0.3f, 0.2f, 0.2f}, {0.0f, 1.0f, 0.0f}},
-        {{ 1.0f, 4.0f, -12.0f}, {0.3f, 0.2f, 0.2f}, {0.0f, 1.0f, 0.0f}},
-        {{-2.0f, 1.0f, -11.0f}, {0.35f, 0.15f, 0.15f}, {0.0f, 1.0f, 0.0f}},
-        {{ 0.5f, 2.5f, -13.5f}, {0.4f, 0.2f, 0.2f}, {0.0f, 1.0f, 0.0f}},
-        {{-1.5f, 2.4f, -12.5f}, {0.4f, 0.3f, 0.3f}, {0.0f, 1.0f, 0.0f}},
-        {{-1.5f, 5.0f, -14.5f}, {0.5f, 0.4f, 0.4f}, {0.0f, 1.0f, 0.0f}},
-        {{-2.5f, 1.7f, -10.0f}, {0.3f, 0.2f, 0.2f}, {0.0f, 1.0f, 0.0f}},
-        {{-1.0f, 3.5f, -13.0f}, {0.4f, 0.3f, 0.3f}, {0.0f, 1.0f, 0.0f}},
-        {{ 2.0f, 4.2f, -15.5f}, {0.3f, 0.3f, 0.3f}, {0.0f, 1.0f, 0.0f}},
-        {{-1.0f, 2.0f, -10.5f}, {0.3f, 0.3f, 0.3f}, {0.0f, 1.0f, 0.0f}}
-    };
-
-    for (auto& fish : fishes)
-    {
-        // Default radius & angle
-        fish.radius = glm::length(glm::vec2(fish.position.x - fish.center.x, fish.position.z - fish.center.z));
-        fish.angle = atan2(fish.position.z - fish.center.z, fish.position.x - fish.center.x);
-    }
+    Simulation sim(jobs);
+    FixedStepper stepper(simHz, maxCatchUp);
+
+    // School of fish (by default one school of 10 around where the shark hunts)
+    FishPool& fishes = sim.fishes;
+    fishes.setMeshRadius(fishModel.boundingRadius());
+    Scenario::generate(scenario, fishes, jobs);
+
+    //// Terrain ////
+    // Split once into 10x10 chunks (the seabed spans about 80x80 units)
+    glm::mat4 terrainModel = glm::mat4(1.0f);
+    terrainModel = glm::translate(terrainModel, glm::vec3(0.0f, -3.0f, 0.0f));
+    terrainModel = glm::scale(terrainModel, glm::vec3(0.08f, 0.08f, 0.08f));
+    ChunkedTerrain terrain(landModel, terrainModel, 10.0f);
+
+    // model.frag fades to fogColor as exp(-(distance * fogDensity)^2); past
+    // this distance the fog is opaque to within 1/255
+    const float fogDensity = 0.025f;
+    const float fogCullDistance = std::sqrt(std::log(255.0f)) / fogDensity;
+
+    //// Culling ////
+    const float sharkCullRadius = 4.0f;     // Encloses the scaled shark model and its sway
+    std::vector<uint32_t> visibleFish, visibleTerrain;
+    Culling::FrameStats cullTotals, cullWindow;
+    uint64_t cullFrames = 0, cullWindowFrames = 0;
+    double cullWindowStart = glfwGetTime();
+
+    // Draws are sorted front to back over the range the fog leaves visible
+    RenderQueue renderQueue;
+    renderQueue.maxDepth = fogCullDistance;
 
     //// RENDER LOOP ////
     while (!glfwWindowShouldClose(window))
@@ -185,198 +374,187 @@ int main()
         lastFrame = currentFrame;
 
         processInput(window);
+        streaming.beginFrame();
+
+        // Fixed-rate simulation ticks, decoupled from the render rate
+        int ticks = stepper.advance(deltaTime);
+        for (int t = 0; t < ticks; ++t)
+        {
+            sim.step(static_cast<float>(stepper.stepSeconds()), simInput);
+            simInput.toggleSchooling = false;
+        }
+        const float alpha = stepper.alpha();
+        const SharkState shark = sim.interpolatedShark(alpha);
+
+        // Camera and projection
+        glm::mat4 projection = glm::perspective(glm::radians(camera.zoom()), (float)SCR_WIDTH / SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+
+        // Camera, light and fog, read by every shader through the FrameConstants block
+        UniformBlocks::FrameConstants frameConstants = {};
+        frameConstants.projection = projection;
+        frameConstants.view = view;
+        frameConstants.viewPos = camera.position();
+        frameConstants.time = currentFrame;
+        frameConstants.ambientLight = glm::vec3(0.0f, 0.3f, 0.5f);
+        frameConstants.fogDensity = fogDensity;
+        frameConstants.lightColor = glm::vec3(0.8f, 0.9f, 1.0f);
+        frameConstants.lightDir = glm::vec3(0.0f, -1.0f, 0.0f);
+        frameConstants.fogColor = glm::vec3(0.0f, 0.2f, 0.4f);
+        UniformBlocks::upload(streaming, frameConstants);
 
         // Clear and draw background
         glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glDepthMask(GL_FALSE);
+        gl.depthMask(false);
         backgroundShader.use();
-        backgroundShader.setFloat("time", glfwGetTime());
-        backgroundShader.setVec3("sunPosition", glm::vec3(0.5f, 0.8f, 0.3f));
-        backgroundShader.setVec3("topColor", glm::vec3(0.0f, 0.3f, 0.5f));
-        backgroundShader.setVec3("bottomColor", glm::vec3(0.0f, 0.1f, 0.2f));
 
-        glBindVertexArray(quadVAO);
+        gl.bindVertexArray(quadVAO);
         glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
-        glDepthMask(GL_TRUE);
+        gl.depthMask(true);
 
-        // Camera and projection
-        glm::mat4 projection = glm::perspective(glm::radians(camera.zoom()), (float)SCR_WIDTH / SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
+        // View-frustum culling: compact lists of what the draws below submit
+        const Culling::Frustum frustum = Culling::Frustum::fromMatrix(projection * view);
+        Culling::FrameStats culled;
+        if (frustumCulling)
+        {
+            culled.terrain = terrain.cull(frustum, camera.position(), fogCullDistance, visibleTerrain);
 
-        if (isSpeedBoostActive)
+            // Fish are drawn up to one tick's movement away from their current position
+            const Culling::Spheres fishBounds = { fishes.posX.data(), fishes.posY.data(), fishes.posZ.data(),
+                                                  fishes.renderRadius.data(), fishes.size() };
+            culled.fish = Culling::cullSpheres(frustum, fishBounds, sim.maxFishStep(), visibleFish);
+
+            culled.shark.tested = 1;
+            culled.shark.visible = frustum.sphereVisible(shark.position, sharkCullRadius) ? 1 : 0;
+        }
+        else
         {
-            speedBoostTimer -= deltaTime;
-            if (speedBoostTimer <= 0.0f) {
-                isSpeedBoostActive = false;
-                speedBoostTimer = 0.0f;
-                hunted = false;
-            }
+            terrain.all(visibleTerrain);
+            visibleFish.resize(fishes.size());
+            for (size_t i = 0; i < visibleFish.size(); ++i)
+                visibleFish[i] = static_cast<uint32_t>(i);
+            culled.terrain = { visibleTerrain.size(), visibleTerrain.size() };
+            culled.fish = { visibleFish.size(), visibleFish.size() };
+            culled.shark = { 1, 1 };
         }
+        cullTotals += culled;
+        cullWindow += culled;
+        ++cullFrames;
+        ++cullWindowFrames;
 
-        // Use modelShader once for all 3D models
-        modelShader.use();
-        modelShader.setVec3("ambientLight", glm::vec3(0.0f, 0.3f, 0.5f));
-        modelShader.setVec3("lightColor", glm::vec3(0.8f, 0.9f, 1.0f));
-        modelShader.setVec3("lightDir", glm::vec3(0.0f, -1.0f, 0.0f));
-        modelShader.setVec3("viewPos", camera.position());
-        modelShader.setMat4("projection", projection);
-        modelShader.setMat4("view", view);
-        modelShader.setFloat("fogDensity", 0.025f);
-        modelShader.setVec3("fogColor", glm::vec3(0.0f, 0.2f, 0.4f));
+        // Once a second, show the averages in the title bar
+        if (currentFrame - cullWindowStart >= 1.0)
+        {
+            const double n = static_cast<double>(cullWindowFrames);
+            std::ostringstream title;
+            title << "Shark_Feeding_Frenzy - fish " << static_cast<size_t>(cullWindow.fish.visible / n)
+                  << "/" << static_cast<size_t>(cullWindow.fish.tested / n)
+                  << " (" << fishRenderer.impostorCount() << " impostors, " << fishRenderer.triangles() / 1000 << "k tris)"
+                  << ", terrain " << static_cast<size_t>(cullWindow.terrain.visible / n)
+                  << "/" << static_cast<size_t>(cullWindow.terrain.tested / n)
+                  << ", shark " << (culled.shark.visible ? "in view" : "culled")
+                  << ", GL calls " << gl.lastFrame().totalIssued() << " (" << gl.lastFrame().totalElided() << " elided)";
+            glfwSetWindowTitle(window, title.str().c_str());
+            cullWindow = Culling::FrameStats();
+            cullWindowFrames = 0;
+            cullWindowStart = currentFrame;
+        }
+
+        // Terrain, fish and shark are queued, then sorted by pass, program,
+        // texture, mesh and distance, and drawn in that order
+        renderQueue.clear();
 
         //// Terrain ////
         {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(0.0f, -3.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(0.08f, 0.08f, 0.08f));
-            modelShader.setMat4("model", model);
-            modelShader.setBool("isShark", false);
-
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, landModel.textures_loaded[0].id);
-            modelShader.setInt("texture_diffuse", 0);
-            landModel.Draw(modelShader);
+            UniformBlocks::ObjectConstants terrainObject;
+            terrainObject.model = terrainModel;
+            terrain.submit(renderQueue, visibleTerrain, camera.position(), modelShader.ID,
+                           landModel.textures_loaded[0].id, renderQueue.addObject(terrainObject));
         }
 
         //// Fish ////
-        for (auto& fish : fishes)
+        const GLuint fishTexture = fishModel.textures_loaded[0].id;
+        if (instancedFish)
         {
-            if (!fish.isActive) continue;
-            float currentSpeed = fish.speed;
-            float currentAngularSpeed = fish.angularSpeed;
+            fishRenderer.selector = LodSelector::forProjection(glm::radians(camera.zoom()), static_cast<float>(SCR_HEIGHT));
+            fishRenderer.upload(fishes, alpha, jobs, camera.position(), &visibleFish);
 
-            if (isSpeedBoostActive)
+            // Without impostors the fade band stays 0, 0, which model.frag reads as no fade
+            UniformBlocks::ObjectConstants fishObject;
+            if (fishRenderer.impostors)
             {
-                currentSpeed *= 3.5f;
-                currentAngularSpeed *= 3.5f;
+                fishObject.impostorFadeStart = fishRenderer.impostorFadeStart;
+                fishObject.impostorFadeEnd = fishRenderer.impostorFadeEnd;
             }
-
-            // Circular motion
-            fish.angle += currentAngularSpeed * deltaTime;
-            fish.position.x = fish.center.x + fish.radius * cos(fish.angle);
-            fish.position.z = fish.center.z + fish.radius * sin(fish.angle);
-
-            glm::vec3 direction = glm::vec3(
-                sin(fish.angle),
-                0.0f,
-                -cos(fish.angle)
-            );
-
-            fish.rotation.y = glm::degrees(atan2(direction.x, direction.z));
-            fish.boundingSphereCenter = fish.position;
-            fish.boundingSphereRadius = 0.8f * glm::max(fish.scale.x, glm::max(fish.scale.y, fish.scale.z));
+            const uint32_t fishObjectIndex = renderQueue.addObject(fishObject);
+            fishRenderer.submit(renderQueue, fishShader.ID, fishTexture, fishModel, fishObjectIndex);
+            fishRenderer.submitImpostors(renderQueue, impostorShader.ID, fishObjectIndex);
         }
-
-        for (const auto& fish : fishes)
+        else
         {
-            if (!fish.isActive) continue;
-
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, fish.position);
-            model = glm::rotate(model, glm::radians(fish.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::scale(model, fish.scale);
-            modelShader.setMat4("model", model);
-            modelShader.setBool("isShark", false);
-
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, fishModel.textures_loaded[0].id);
-            modelShader.setInt("texture_diffuse", 0);
-
-            fishModel.Draw(modelShader);
+            for (uint32_t i : visibleFish)
+            {
+                UniformBlocks::ObjectConstants fishObject;
+                fishObject.model = fishes.modelMatrix(i, alpha);
+                const uint32_t object = renderQueue.addObject(fishObject);
+                const float distance = glm::length(fishes.position(i) - camera.position());
+                for (const Mesh& mesh : fishModel.meshes)
+                {
+                    RenderQueue::DrawItem item;
+                    item.program = modelShader.ID;
+                    item.textures[0] = fishTexture;
+                    item.vao = mesh.VAO;
+                    item.count = static_cast<GLsizei>(mesh.indices.size());
+                    item.object = object;
+                    renderQueue.submit(RenderQueue::kOpaque, item, distance);
+                }
+            }
         }
 
         //// Shark ////
-        bool isCollision = false;
-        for (auto& fish : fishes)
+        if (culled.shark.visible)
         {
-            if (!fish.isActive) continue;
-
-            BoundingSphere fishSphere = { fish.boundingSphereCenter, fish.boundingSphereRadius };
-
-            // Check if the shark should start hunting
-            if (checkCollision(sharkBoundingSphere1, fishSphere))
+            // One ranged draw per submesh (body, eyes, teeth), each with its
+            // own meshID for the sway in model.vert
+            UniformBlocks::ObjectConstants sharkObject;
+            sharkObject.model = shark.modelMatrix();
+            sharkObject.isShark = 1;
+            sharkObject.swayMultiplier = shark.hunting ? 3.0f : 1.5f;     // In hunting mode, the shark sways harder
+
+            RenderQueue::DrawItem item;
+            item.program = modelShader.ID;
+            item.textures[0] = sharkTexture.GetRendererID();
+            item.vao = sharkMeshData.vao;
+            item.indexType = sharkMeshData.indexType;
+            const float distance = glm::length(shark.position - camera.position());
+            const std::vector<FBXModel::MeshInfo>& sharkMeshes = sharkModel.getMeshes();
+            for (size_t meshID = 0; meshID < sharkMeshes.size(); ++meshID)
             {
-                isCollision = true;
+                item.first = sharkMeshes[meshID].firstIndex;
+                item.count = static_cast<GLsizei>(sharkMeshes[meshID].indexCount);
+                sharkObject.meshID = static_cast<int>(meshID);
+                item.object = renderQueue.addObject(sharkObject);
+                renderQueue.submit(RenderQueue::kOpaque, item, distance);
             }
-
-            if (hunted) continue;
-
-            // Check if the shark can eat the fish
-            if (checkCollision(sharkBoundingSphere2, fishSphere))
-            {
-                fish.isActive = false;
-                hunted = true;
-                isSpeedBoostActive = true;
-                speedBoostTimer = 4.0f;
-            }
-        }
-
-        // In hunting mode, the shark will get more speed
-        if (isCollision)
-        {
-            sharkSpeed = 1.0f;
-            turnSpeed = 20.0f;
-            modelShader.setFloat("swayMultiplier", 3.0f);
         }
-        else {
-            sharkSpeed = 0.4f;
-            turnSpeed = 10.0f;
-        }
-
-        // Update shark direction and position
-        glm::vec3 sharkDirection = glm::normalize(glm::vec3(
-            cos(glm::radians(sharkDirectionAngle)) * cos(glm::radians(sharkPitchAngle)),
-            glm::clamp(sin(glm::radians(sharkPitchAngle)), -0.5f, 0.5f),
-            sin(glm::radians(sharkDirectionAngle)) * cos(glm::radians(sharkPitchAngle))
-        ));
 
-        // In case that the shark goes below the land
-        if (sharkPosition.y < -1.0f)
-        {
-            sharkPitchAngle = glm::clamp(sharkPitchAngle + verticalTurnSpeed * deltaTime, 0.0f, 30.0f);
-        }
+        renderQueue.execute(streaming);
 
-        sharkPosition += sharkDirection * sharkSpeed * deltaTime;
-
-        if (sharkPosition.y < -1.0f)
-        {
-            sharkPosition.y = -1.0f;
-        }
-
-        // Update shark bounding spheres
-        sharkBoundingSphere1.center = sharkPosition;
-        sharkBoundingSphere2.center = sharkPosition;
-
-        // Shark drawing
-        modelShader.setFloat("time", currentFrame);
-        for (int meshID = 0; meshID < 3; ++meshID) 
-        {
-            modelShader.setBool("isShark", true);
-            modelShader.setInt("meshID", meshID);
-
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, sharkPosition);
-            model = glm::rotate(model, glm::radians(-sharkDirectionAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::rotate(model, glm::radians(sharkPitchAngle), glm::vec3(0.0f, 0.0f, 1.0f));
-            model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-            modelShader.setMat4("model", model);
-
-            sharkTexture.Bind(0);
-            modelShader.setInt("texture_diffuse", 0);
-
-            glBindVertexArray(sharkMeshData.vao);
-            glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(sharkMeshData.vertexCount));
-            glBindVertexArray(0);
-        }
+        streaming.endFrame();
+        gl.endFrame();
 
         // Swap and poll
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    jobs.printStats(std::cout);
+    streaming.printStats(std::cout);
+    gl.printStats(std::cout);
+    Culling::printStats(std::cout, cullTotals, cullFrames);
+
     glfwTerminate();
     return 0;
 }
@@ -415,20 +593,26 @@ void processInput(GLFWwindow* window)
     //// Shark Control ////
     // Q - left
     // E - right
+    simInput.turn = 0.0f;
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-        sharkDirectionAngle -= turnSpeed * deltaTime;
+        simInput.turn -= 1.0f;
     if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-        sharkDirectionAngle += turnSpeed * deltaTime;
+        simInput.turn += 1.0f;
 
     // Z - up
     // C - down
+    simInput.pitch = 0.0f;
     if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS)
-        sharkPitchAngle += verticalTurnSpeed * deltaTime;
+        simInput.pitch += 1.0f;
     if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
-        sharkPitchAngle -= verticalTurnSpeed * deltaTime;
-
-    // Avoid flip upside down
-    sharkPitchAngle = glm::clamp(sharkPitchAngle, -30.0f, 30.0f);
+        simInput.pitch -= 1.0f;
+
+    // F - toggle schooling (on key press, not while held)
+    static bool fWasDown = false;
+    bool fDown = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (fDown && !fWasDown)
+        simInput.toggleSchooling = true;
+    fWasDown = fDown;
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) 
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <glad/glad.h>
+#include "gl_state.hpp"
 #include "stb_image/stb_image.h"
 
 class TexFBX {
@@ -20,6 +21,7 @@ public:
 
     inline int GetWidth() const { return m_Width; }
     inline int GetHeight() const { return m_Height; }
+    inline unsigned int GetRendererID() const { return m_RendererID; }
 };
 
 // Implementation
@@ -29,7 +31,7 @@ TexFBX::TexFBX(const std::string& path)
     m_LocalBuffer = stbi_load(path.c_str(), &m_Width, &m_Height, &m_BPP, 4);
 
     glGenTextures(1, &m_RendererID);
-    glBindTexture(GL_TEXTURE_2D, m_RendererID);
+    GlState::current().bindTexture(0, m_RendererID);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -37,7 +39,7 @@ TexFBX::TexFBX(const std::string& path)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_Width, m_Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_LocalBuffer);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GlState::current().bindTexture(0, 0);
 
     if (m_LocalBuffer) {
         stbi_image_free(m_LocalBuffer);
@@ -45,14 +47,15 @@ TexFBX::TexFBX(const std::string& path)
 }
 
 TexFBX::~TexFBX() {
+    GlState::current().forgetTexture(m_RendererID);
     glDeleteTextures(1, &m_RendererID);
 }
 
+// Skipped by GlState when the texture is already on that unit
 void TexFBX::Bind(unsigned int slot) const {
-    glActiveTexture(GL_TEXTURE0 + slot);
-    glBindTexture(GL_TEXTURE_2D, m_RendererID);
+    GlState::current().bindTexture(slot, m_RendererID);
 }
 
 void TexFBX::UnBind() const {
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GlState::current().bindTexture(0, 0);
 }
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include "fish_pool.hpp"
+#include "spatial_grid.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Broadphase for sphere queries against the fish school (shark hunt and bite
+// spheres). Fish are bucketed in a SpatialHashGrid, so a query only looks at
+// the buckets its sphere overlaps instead of every fish.
+//
+// The grid is rebuilt lazily: between rebuilds the caller reports an upper
+// bound on how far any fish has moved (addDrift), queries grow their radius by
+// that much, and the narrow phase tests the current positions. Once the drift
+// passes the slack the next query rebuilds. Removals and additions are patched
+// in (onRemove / onAdd) so eating a fish does not force an O(n) rebuild.
+class FishBroadphase
+{
+public:
+    struct Stats
+    {
+        uint64_t queries = 0;
+        uint64_t candidates = 0;    // Narrow-phase distance tests
+        uint64_t rebuilds = 0;
+    };
+
+    explicit FishBroadphase(float cellSize = 3.0f, float slack = 2.0f)
+        : cellSize_(cellSize), slack_(slack)
+    {
+    }
+
+    const Stats& stats() const { return stats_; }
+    void resetStats() { stats_ = Stats(); }
+
+    // Every fish moved at most distance since the last call
+    void addDrift(float distance)
+    {
+        drift_ += distance;
+    }
+
+    // Forces a rebuild on the next query
+    void invalidate()
+    {
+        valid_ = false;
+    }
+
+    // Call before FishPool::removeAt(i): the last fish is about to move to index i
+    void onRemove(const FishPool& fishes, size_t i)
+    {
+        if (!valid_)
+            return;
+
+        const size_t last = fishes.size() - 1;
+        if (!relabelAdded(i, kRemoved))
+        {
+            grid_.relabel(i, kRemoved);
+            --built_;
+        }
+        if (i != last && !relabelAdded(last, static_cast<uint32_t>(i)))
+            grid_.relabel(last, static_cast<uint32_t>(i));
+    }
+
+    // Call after FishPool::add(); the new fish is tested directly until the next rebuild
+    void onAdd(size_t i)
+    {
+        if (valid_)
+            added_.push_back(static_cast<uint32_t>(i));
+    }
+
+    // Calls fn(i) for every fish that may be within radius of center (plus its
+    // own bounding radius), without a distance test. fn may return false to stop
+    // early; the return value says whether the query ran to completion.
+    template <typename Fn>
+    bool forEachCandidate(const FishPool& fishes, const glm::vec3& center, float radius, Fn&& fn)
+    {
+        if (!valid_ || drift_ > slack_ || built_ + added_.size() != fishes.size())
+            rebuild(fishes);
+
+        ++stats_.queries;
+        uint64_t tested = 0;
+        const float searchRadius = radius + maxFishRadius_ + drift_;
+        bool completed = grid_.forEachCandidate(center, searchRadius, [&](size_t i)
+        {
+            if (i == kRemoved)
+                return true;
+            ++tested;
+            return fn(i);
+        });
+        for (size_t k = 0; completed && k < added_.size(); ++k)
+        {
+            ++tested;
+            completed = fn(static_cast<size_t>(added_[k]));
+        }
+
+        stats_.candidates += tested;
+        return completed;
+    }
+
+    // Calls fn(i, distanceSquared) for every fish whose bounding sphere overlaps
+    // the sphere (center, radius). Stops early like forEachCandidate.
+    template <typename Fn>
+    bool forEachOverlap(const FishPool& fishes, const glm::vec3& center, float radius, Fn&& fn)
+    {
+        return forEachCandidate(fishes, center, radius, [&](size_t i)
+        {
+            const float dx = fishes.posX[i] - center.x;
+            const float dy = fishes.posY[i] - center.y;
+            const float dz = fishes.posZ[i] - center.z;
+            const float distance2 = dx * dx + dy * dy + dz * dz;
+            const float reach = radius + fishes.boundingRadius[i];
+            if (distance2 > reach * reach)
+                return true;
+            return fn(i, distance2);
+        });
+    }
+
+    // True if any fish overlaps the sphere
+    bool anyOverlap(const FishPool& fishes, const glm::vec3& center, float radius)
+    {
+        return !forEachOverlap(fishes, center, radius, [](size_t, float) { return false; });
+    }
+
+    // Lowest dense index among the fish overlapping the sphere, or FishPool::npos
+    size_t firstOverlap(const FishPool& fishes, const glm::vec3& center, float radius)
+    {
+        size_t first = FishPool::npos;
+        forEachOverlap(fishes, center, radius, [&](size_t i, float)
+        {
+            first = std::min(first, i);
+            return true;
+        });
+        return first;
+    }
+
+private:
+    void rebuild(const FishPool& fishes)
+    {
+        grid_.build(fishes.posX.data(), fishes.posY.data(), fishes.posZ.data(), fishes.size(), cellSize_);
+        maxFishRadius_ = 0.0f;
+        for (float r : fishes.boundingRadius)
+            maxFishRadius_ = std::max(maxFishRadius_, r);
+
+        built_ = fishes.size();
+        added_.clear();
+        drift_ = 0.0f;
+        valid_ = true;
+        ++stats_.rebuilds;
+    }
+
+    static constexpr uint32_t kRemoved = SpatialHashGrid::kNoPoint;
+
+    // Renames fish `from` if it is one of the fish added since the last rebuild
+    bool relabelAdded(size_t from, uint32_t to)
+    {
+        for (size_t k = 0; k < added_.size(); ++k)
+        {
+            if (added_[k] != from)
+                continue;
+            if (to == kRemoved)
+            {
+                added_[k] = added_.back();
+                added_.pop_back();
+            }
+            else
+            {
+                added_[k] = to;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    SpatialHashGrid grid_;
+    std::vector<uint32_t> added_;   // Fish added since the last rebuild
+    float cellSize_;
+    float slack_;                   // Drift allowed before a rebuild
+    float drift_ = 0.0f;
+    float maxFishRadius_ = 0.0f;
+    size_t built_ = 0;
+    bool valid_ = false;
+    Stats stats_;
+};
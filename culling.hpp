@@ -0,0 +1,387 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+// View-frustum culling over structure-of-arrays bounds.
+//
+// The six planes are pulled from projection * view (Gribb/Hartmann) and point
+// inwards, so a point p is inside when dot(n, p) + d >= 0 for all of them.
+// Spheres and boxes are tested 8 at a time (AVX2) or 4 at a time (SSE4.1) and
+// the survivors are written as a compact index list for the draw stage.
+// Tests are conservative: near the frustum corners an object can be kept
+// although it is outside, never the other way round.
+namespace Culling
+{
+    struct Frustum
+    {
+        glm::vec4 planes[6];    // (n.x, n.y, n.z, d), n normalised
+
+        static Frustum fromMatrix(const glm::mat4& viewProjection)
+        {
+            const glm::mat4& m = viewProjection;
+            const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+            const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+            const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+            const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+            Frustum f;
+            f.planes[0] = row3 + row0;  // Left
+            f.planes[1] = row3 - row0;  // Right
+            f.planes[2] = row3 + row1;  // Bottom
+            f.planes[3] = row3 - row1;  // Top
+            f.planes[4] = row3 + row2;  // Near
+            f.planes[5] = row3 - row2;  // Far
+            for (glm::vec4& p : f.planes)
+                p /= glm::length(glm::vec3(p));
+            return f;
+        }
+
+        bool sphereVisible(const glm::vec3& center, float radius) const
+        {
+            for (const glm::vec4& p : planes)
+            {
+                if (glm::dot(glm::vec3(p), center) + p.w < -radius)
+                    return false;
+            }
+            return true;
+        }
+
+        bool boxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+        {
+            const glm::vec3 center = 0.5f * (boxMin + boxMax);
+            const glm::vec3 extent = 0.5f * (boxMax - boxMin);
+            for (const glm::vec4& p : planes)
+            {
+                const glm::vec3 n(p);
+                if (glm::dot(n, center) + p.w < -glm::dot(glm::abs(n), extent))
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    // Bounding spheres, one entry per object
+    struct Spheres
+    {
+        const float* x;
+        const float* y;
+        const float* z;
+        const float* radius;
+        size_t count;
+    };
+
+    // Axis-aligned boxes as centre and half extent
+    struct Boxes
+    {
+        const float* centerX;
+        const float* centerY;
+        const float* centerZ;
+        const float* extentX;
+        const float* extentY;
+        const float* extentZ;
+        size_t count;
+    };
+
+    // Owns the streams behind a Boxes view
+    struct BoxList
+    {
+        std::vector<float> centerX, centerY, centerZ;
+        std::vector<float> extentX, extentY, extentZ;
+
+        size_t size() const { return centerX.size(); }
+
+        void add(const glm::vec3& boxMin, const glm::vec3& boxMax)
+        {
+            const glm::vec3 center = 0.5f * (boxMin + boxMax);
+            const glm::vec3 extent = 0.5f * (boxMax - boxMin);
+            centerX.push_back(center.x);
+            centerY.push_back(center.y);
+            centerZ.push_back(center.z);
+            extentX.push_back(extent.x);
+            extentY.push_back(extent.y);
+            extentZ.push_back(extent.z);
+        }
+
+        // Adds the world-space box around a local box placed by transform
+        void add(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& transform)
+        {
+            glm::vec3 boxMin(std::numeric_limits<float>::max());
+            glm::vec3 boxMax(-std::numeric_limits<float>::max());
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                const glm::vec3 local((corner & 1) ? localMax.x : localMin.x,
+                                      (corner & 2) ? localMax.y : localMin.y,
+                                      (corner & 4) ? localMax.z : localMin.z);
+                const glm::vec3 world = glm::vec3(transform * glm::vec4(local, 1.0f));
+                boxMin = glm::min(boxMin, world);
+                boxMax = glm::max(boxMax, world);
+            }
+            add(boxMin, boxMax);
+        }
+
+        Boxes view() const
+        {
+            return { centerX.data(), centerY.data(), centerZ.data(),
+                     extentX.data(), extentY.data(), extentZ.data(), size() };
+        }
+    };
+
+    // Tested and visible counts of one culling pass
+    struct CullStats
+    {
+        size_t tested = 0;
+        size_t visible = 0;
+
+        CullStats& operator+=(const CullStats& other)
+        {
+            tested += other.tested;
+            visible += other.visible;
+            return *this;
+        }
+    };
+
+    // What one frame (or a sum of frames) culled, per kind of object
+    struct FrameStats
+    {
+        CullStats fish;
+        CullStats shark;
+        CullStats terrain;
+
+        FrameStats& operator+=(const FrameStats& other)
+        {
+            fish += other.fish;
+            shark += other.shark;
+            terrain += other.terrain;
+            return *this;
+        }
+    };
+
+    // Average visible / tested per frame over `frames` frames summed in totals
+    inline void printStats(std::ostream& out, const FrameStats& totals, uint64_t frames)
+    {
+        const double n = static_cast<double>(std::max<uint64_t>(frames, 1));
+        auto line = [&](const char* name, const CullStats& s)
+        {
+            out << "  " << name << ": " << s.visible / n << " of " << s.tested / n << " visible";
+            if (s.tested > 0)
+                out << " (" << 100.0 * s.visible / s.tested << "%)";
+            out << std::endl;
+        };
+
+        out << "Culling, per frame over " << frames << " frames (" << simdLevelName(cpuSimdLevel()) << "):" << std::endl;
+        out << std::fixed << std::setprecision(1);
+        line("fish", totals.fish);
+        line("shark", totals.shark);
+        line("terrain chunks", totals.terrain);
+        out << std::defaultfloat;
+    }
+
+    // The kernels append the indices of visible objects in [begin, end) to out
+    // (room for end - begin entries) and return how many they wrote. margin
+    // grows every sphere, e.g. by how far it may move before it is drawn.
+    inline size_t cullSpheresScalar(const Frustum& f, const Spheres& s, size_t begin, size_t end, float margin, uint32_t* out)
+    {
+        size_t written = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (f.sphereVisible(glm::vec3(s.x[i], s.y[i], s.z[i]), s.radius[i] + margin))
+                out[written++] = static_cast<uint32_t>(i);
+        }
+        return written;
+    }
+
+    inline size_t cullBoxesScalar(const Frustum& f, const Boxes& b, size_t begin, size_t end, uint32_t* out)
+    {
+        size_t written = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            const glm::vec3 center(b.centerX[i], b.centerY[i], b.centerZ[i]);
+            const glm::vec3 extent(b.extentX[i], b.extentY[i], b.extentZ[i]);
+            if (f.boxVisible(center - extent, center + extent))
+                out[written++] = static_cast<uint32_t>(i);
+        }
+        return written;
+    }
+
+    // Appends base + the set bits of mask
+    inline size_t emitMask(unsigned mask, size_t base, uint32_t* out)
+    {
+        size_t written = 0;
+        while (mask)
+        {
+            unsigned bit = 0;
+            while (!(mask & (1u << bit)))
+                ++bit;
+            out[written++] = static_cast<uint32_t>(base + bit);
+            mask &= mask - 1;
+        }
+        return written;
+    }
+
+#if defined(SHARK_SIMD_X86)
+    SHARK_TARGET_SSE41
+    inline size_t cullSpheresSSE41(const Frustum& f, const Spheres& s, size_t begin, size_t end, float margin, uint32_t* out)
+    {
+        const __m128 vMargin = _mm_set1_ps(margin);
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+        size_t written = 0;
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            const __m128 x = _mm_loadu_ps(s.x + i);
+            const __m128 y = _mm_loadu_ps(s.y + i);
+            const __m128 z = _mm_loadu_ps(s.z + i);
+            const __m128 negR = _mm_xor_ps(_mm_add_ps(_mm_loadu_ps(s.radius + i), vMargin), signBit);
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (const glm::vec4& p : f.planes)
+            {
+                __m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), x), _mm_set1_ps(p.w));
+                d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.y), y), d);
+                d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.z), z), d);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+            }
+            written += emitMask(static_cast<unsigned>(_mm_movemask_ps(inside)), i, out + written);
+        }
+        return written + cullSpheresScalar(f, s, i, end, margin, out + written);
+    }
+
+    SHARK_TARGET_SSE41
+    inline size_t cullBoxesSSE41(const Frustum& f, const Boxes& b, size_t begin, size_t end, uint32_t* out)
+    {
+        size_t written = 0;
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            const __m128 cx = _mm_loadu_ps(b.centerX + i);
+            const __m128 cy = _mm_loadu_ps(b.centerY + i);
+            const __m128 cz = _mm_loadu_ps(b.centerZ + i);
+            const __m128 ex = _mm_loadu_ps(b.extentX + i);
+            const __m128 ey = _mm_loadu_ps(b.extentY + i);
+            const __m128 ez = _mm_loadu_ps(b.extentZ + i);
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (const glm::vec4& p : f.planes)
+            {
+                // Signed distance of the centre plus the box's projected radius
+                __m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), cx), _mm_set1_ps(p.w));
+                d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.y), cy), d);
+                d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.z), cz), d);
+                d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(p.x)), ex), d);
+                d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(p.y)), ey), d);
+                d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(p.z)), ez), d);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+            }
+            written += emitMask(static_cast<unsigned>(_mm_movemask_ps(inside)), i, out + written);
+        }
+        return written + cullBoxesScalar(f, b, i, end, out + written);
+    }
+
+    SHARK_TARGET_AVX2
+    inline size_t cullSpheresAVX2(const Frustum& f, const Spheres& s, size_t begin, size_t end, float margin, uint32_t* out)
+    {
+        const __m256 vMargin = _mm256_set1_ps(margin);
+        const __m256 signBit = _mm256_set1_ps(-0.0f);
+        size_t written = 0;
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8)
+        {
+            const __m256 x = _mm256_loadu_ps(s.x + i);
+            const __m256 y = _mm256_loadu_ps(s.y + i);
+            const __m256 z = _mm256_loadu_ps(s.z + i);
+            const __m256 negR = _mm256_xor_ps(_mm256_add_ps(_mm256_loadu_ps(s.radius + i), vMargin), signBit);
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (const glm::vec4& p : f.planes)
+            {
+                __m256 d = _mm256_fmadd_ps(_mm256_set1_ps(p.x), x, _mm256_set1_ps(p.w));
+                d = _mm256_fmadd_ps(_mm256_set1_ps(p.y), y, d);
+                d = _mm256_fmadd_ps(_mm256_set1_ps(p.z), z, d);
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+            }
+            written += emitMask(static_cast<unsigned>(_mm256_movemask_ps(inside)), i, out + written);
+        }
+        return written + cullSpheresScalar(f, s, i, end, margin, out + written);
+    }
+
+    SHARK_TARGET_AVX2
+    inline size_t cullBoxesAVX2(const Frustum& f, const Boxes& b, size_t begin, size_t end, uint32_t* out)
+    {
+        size_t written = 0;
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8)
+        {
+            const __m256 cx = _mm256_loadu_ps(b.centerX + i);
+            const __m256 cy = _mm256_loadu_ps(b.centerY + i);
+            const __m256 cz = _mm256_loadu_ps(b.centerZ + i);
+            const __m256 ex = _mm256_loadu_ps(b.extentX + i);
+            const __m256 ey = _mm256_loadu_ps(b.extentY + i);
+            const __m256 ez = _mm256_loadu_ps(b.extentZ + i);
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (const glm::vec4& p : f.planes)
+            {
+                __m256 d = _mm256_fmadd_ps(_mm256_set1_ps(p.x), cx, _mm256_set1_ps(p.w));
+                d = _mm256_fmadd_ps(_mm256_set1_ps(p.y), cy, d);
+                d = _mm256_fmadd_ps(_mm256_set1_ps(p.z), cz, d);
+                d = _mm256_fmadd_ps(_mm256_set1_ps(std::abs(p.x)), ex, d);
+                d = _mm256_fmadd_ps(_mm256_set1_ps(std::abs(p.y)), ey, d);
+                d = _mm256_fmadd_ps(_mm256_set1_ps(std::abs(p.z)), ez, d);
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+            }
+            written += emitMask(static_cast<unsigned>(_mm256_movemask_ps(inside)), i, out + written);
+        }
+        return written + cullBoxesScalar(f, b, i, end, out + written);
+    }
+#endif
+
+    using SphereKernel = size_t (*)(const Frustum&, const Spheres&, size_t, size_t, float, uint32_t*);
+    using BoxKernel = size_t (*)(const Frustum&, const Boxes&, size_t, size_t, uint32_t*);
+
+    inline SphereKernel sphereKernelFor(SimdLevel level)
+    {
+#if defined(SHARK_SIMD_X86)
+        if (level == SimdLevel::kAVX2)  return cullSpheresAVX2;
+        if (level == SimdLevel::kSSE41) return cullSpheresSSE41;
+#endif
+        return cullSpheresScalar;
+    }
+
+    inline BoxKernel boxKernelFor(SimdLevel level)
+    {
+#if defined(SHARK_SIMD_X86)
+        if (level == SimdLevel::kAVX2)  return cullBoxesAVX2;
+        if (level == SimdLevel::kSSE41) return cullBoxesSSE41;
+#endif
+        return cullBoxesScalar;
+    }
+
+    // Replaces visible with the indices of the spheres inside the frustum
+    inline CullStats cullSpheres(const Frustum& f, const Spheres& s, float margin, std::vector<uint32_t>& visible)
+    {
+        static const SphereKernel kernel = sphereKernelFor(cpuSimdLevel());
+        visible.resize(s.count);
+        visible.resize(kernel(f, s, 0, s.count, margin, visible.data()));
+        return { s.count, visible.size() };
+    }
+
+    // Replaces visible with the indices of the boxes inside the frustum
+    inline CullStats cullBoxes(const Frustum& f, const Boxes& b, std::vector<uint32_t>& visible)
+    {
+        static const BoxKernel kernel = boxKernelFor(cpuSimdLevel());
+        visible.resize(b.count);
+        visible.resize(kernel(f, b, 0, b.count, visible.data()));
+        return { b.count, visible.size() };
+    }
+}
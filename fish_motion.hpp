@@ -0,0 +1,339 @@
+#pragma once
+
+#include "simd.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+// Batched circular-motion kernel for the fish school.
+//
+// Per fish: angle += angularSpeed * step, wrapped to [-pi, pi];
+//           position.xz = center.xz + radius * (cos, sin)(angle);
+//           heading.xz = orbit tangent (sin, -cos)(angle).
+// The heading is kept as a unit vector, so no atan2 is needed: model matrices
+// are built straight from it (see FishPool::modelMatrix).
+//
+// sin/cos use a Cephes-style polynomial on [-pi/4, pi/4] after reduction by pi/2.
+// Against the std::cos/std::sin reference path the absolute error of sin/cos is
+// below 5e-7 for wrapped angles, so positions match within 5e-7 * radius
+// (plus float rounding of the add) and headings within 5e-7 per component.
+namespace FishMotion
+{
+    struct Streams
+    {
+        float* angle;
+        float* posX;
+        float* posZ;
+        float* headingX;
+        float* headingZ;
+        const float* angularSpeed;
+        const float* radius;
+        const float* centerX;
+        const float* centerZ;
+        size_t count;
+    };
+
+    constexpr float kTwoPi = 6.28318530717958647692f;
+    constexpr float kInvTwoPi = 0.15915494309189533577f;
+    constexpr float kTwoOverPi = 0.63661977236758134308f;
+    constexpr float kPiOver2Hi = 1.5707963705062866211f;    // float(pi/2)
+    constexpr float kPiOver2Lo = -4.3711388286737929e-08f;  // pi/2 - float(pi/2)
+
+    constexpr float kSin1 = -1.6666654611e-1f;
+    constexpr float kSin2 = 8.3321608736e-3f;
+    constexpr float kSin3 = -1.9515295891e-4f;
+    constexpr float kCos1 = 4.166664568298827e-2f;
+    constexpr float kCos2 = -1.388731625493765e-3f;
+    constexpr float kCos3 = 2.443315711809948e-5f;
+
+    // Scalar version of the polynomial, also used for the SIMD tails. The SSE
+    // kernel matches it operation for operation; the AVX2 kernel fuses the
+    // multiply-adds, so its fish can differ from a tail fish in the last bits.
+    inline void sincosPoly(float x, float& s, float& c)
+    {
+        const float q = std::nearbyint(x * kTwoOverPi);
+        const int quadrant = static_cast<int>(q);
+        const float r = (x - q * kPiOver2Hi) - q * kPiOver2Lo;
+        const float z = r * r;
+
+        const float sr = r + r * z * (kSin1 + z * (kSin2 + z * kSin3));
+        const float cr = 1.0f - 0.5f * z + z * z * (kCos1 + z * (kCos2 + z * kCos3));
+
+        const bool swap = (quadrant & 1) != 0;
+        s = swap ? cr : sr;
+        c = swap ? sr : cr;
+        if (quadrant & 2) s = -s;
+        if ((quadrant + 1) & 2) c = -c;
+    }
+
+    inline float wrapAngle(float a)
+    {
+        return a - kTwoPi * std::nearbyint(a * kInvTwoPi);
+    }
+
+    constexpr float kPi = 3.14159265358979323846f;
+    constexpr float kTanPiOver8 = 0.41421356237309504880f;
+
+    constexpr float kAtan1 = -3.33329491539e-1f;
+    constexpr float kAtan2 = 1.99777106478e-1f;
+    constexpr float kAtan3 = -1.38776856032e-1f;
+    constexpr float kAtan4 = 8.05374449538e-2f;
+
+    // atan2 from a Cephes-style polynomial, within 3e-7 (about an ulp near pi)
+    // of std::atan2. Only basic arithmetic, so generated orbit angles are the
+    // same under every C runtime.
+    inline float atan2Poly(float y, float x)
+    {
+        const float ax = std::abs(x);
+        const float ay = std::abs(y);
+        if (ax == 0.0f && ay == 0.0f)
+            return 0.0f;
+
+        // atan(t) for t in [0, 1], reduced to |t| <= tan(pi/8) around pi/4
+        float t = std::min(ax, ay) / std::max(ax, ay);
+        float base = 0.0f;
+        if (t > kTanPiOver8)
+        {
+            base = 0.25f * kPi;
+            t = (t - 1.0f) / (t + 1.0f);
+        }
+        const float z = t * t;
+        float a = base + t + t * z * (kAtan1 + z * (kAtan2 + z * (kAtan3 + z * kAtan4)));
+
+        if (ay > ax) a = 0.5f * kPi - a;
+        if (x < 0.0f) a = kPi - a;
+        return y < 0.0f ? -a : a;
+    }
+
+    inline void advanceScalar(const Streams& f, size_t begin, size_t end, float step)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const float theta = wrapAngle(f.angle[i] + f.angularSpeed[i] * step);
+            float s, c;
+            sincosPoly(theta, s, c);
+
+            f.angle[i] = theta;
+            f.posX[i] = f.centerX[i] + f.radius[i] * c;
+            f.posZ[i] = f.centerZ[i] + f.radius[i] * s;
+            f.headingX[i] = s;
+            f.headingZ[i] = -c;
+        }
+    }
+
+    // The original per-fish path with libm, kept as the accuracy reference
+    inline void advanceReference(const Streams& f, size_t begin, size_t end, float step)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const float theta = wrapAngle(f.angle[i] + f.angularSpeed[i] * step);
+
+            f.angle[i] = theta;
+            f.posX[i] = f.centerX[i] + f.radius[i] * std::cos(theta);
+            f.posZ[i] = f.centerZ[i] + f.radius[i] * std::sin(theta);
+            f.headingX[i] = std::sin(theta);
+            f.headingZ[i] = -std::cos(theta);
+        }
+    }
+
+#if defined(SHARK_SIMD_X86)
+    SHARK_TARGET_SSE41
+    inline void sincosSSE41(__m128 x, __m128& s, __m128& c)
+    {
+        const __m128 q = _mm_round_ps(_mm_mul_ps(x, _mm_set1_ps(kTwoOverPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        const __m128i quadrant = _mm_cvtps_epi32(q);
+        __m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(kPiOver2Hi)));
+        r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(kPiOver2Lo)));
+        const __m128 z = _mm_mul_ps(r, r);
+
+        __m128 ps = _mm_add_ps(_mm_set1_ps(kSin2), _mm_mul_ps(z, _mm_set1_ps(kSin3)));
+        ps = _mm_add_ps(_mm_set1_ps(kSin1), _mm_mul_ps(z, ps));
+        const __m128 sr = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z), ps));
+
+        __m128 pc = _mm_add_ps(_mm_set1_ps(kCos2), _mm_mul_ps(z, _mm_set1_ps(kCos3)));
+        pc = _mm_add_ps(_mm_set1_ps(kCos1), _mm_mul_ps(z, pc));
+        __m128 cr = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), z));
+        cr = _mm_add_ps(cr, _mm_mul_ps(_mm_mul_ps(z, z), pc));
+
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i two = _mm_set1_epi32(2);
+        const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+        const __m128 signS = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+        const __m128 signC = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30));
+
+        s = _mm_xor_ps(_mm_blendv_ps(sr, cr, swap), signS);
+        c = _mm_xor_ps(_mm_blendv_ps(cr, sr, swap), signC);
+    }
+
+    SHARK_TARGET_SSE41
+    inline void advanceSSE41(const Streams& f, size_t begin, size_t end, float step)
+    {
+        const __m128 vStep = _mm_set1_ps(step);
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128 theta = _mm_add_ps(_mm_loadu_ps(f.angle + i), _mm_mul_ps(_mm_loadu_ps(f.angularSpeed + i), vStep));
+            const __m128 turns = _mm_round_ps(_mm_mul_ps(theta, _mm_set1_ps(kInvTwoPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            theta = _mm_sub_ps(theta, _mm_mul_ps(turns, _mm_set1_ps(kTwoPi)));
+
+            __m128 s, c;
+            sincosSSE41(theta, s, c);
+
+            const __m128 r = _mm_loadu_ps(f.radius + i);
+            _mm_storeu_ps(f.angle + i, theta);
+            _mm_storeu_ps(f.posX + i, _mm_add_ps(_mm_loadu_ps(f.centerX + i), _mm_mul_ps(r, c)));
+            _mm_storeu_ps(f.posZ + i, _mm_add_ps(_mm_loadu_ps(f.centerZ + i), _mm_mul_ps(r, s)));
+            _mm_storeu_ps(f.headingX + i, s);
+            _mm_storeu_ps(f.headingZ + i, _mm_xor_ps(c, signBit));
+        }
+        advanceScalar(f, i, end, step);
+    }
+
+    SHARK_TARGET_AVX2
+    inline void sincosAVX2(__m256 x, __m256& s, __m256& c)
+    {
+        const __m256 q = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(kTwoOverPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        const __m256i quadrant = _mm256_cvtps_epi32(q);
+        __m256 r = _mm256_fnmadd_ps(q, _mm256_set1_ps(kPiOver2Hi), x);
+        r = _mm256_fnmadd_ps(q, _mm256_set1_ps(kPiOver2Lo), r);
+        const __m256 z = _mm256_mul_ps(r, r);
+
+        __m256 ps = _mm256_fmadd_ps(z, _mm256_set1_ps(kSin3), _mm256_set1_ps(kSin2));
+        ps = _mm256_fmadd_ps(z, ps, _mm256_set1_ps(kSin1));
+        const __m256 sr = _mm256_fmadd_ps(_mm256_mul_ps(r, z), ps, r);
+
+        __m256 pc = _mm256_fmadd_ps(z, _mm256_set1_ps(kCos3), _mm256_set1_ps(kCos2));
+        pc = _mm256_fmadd_ps(z, pc, _mm256_set1_ps(kCos1));
+        __m256 cr = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, _mm256_set1_ps(1.0f));
+        cr = _mm256_fmadd_ps(_mm256_mul_ps(z, z), pc, cr);
+
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i two = _mm256_set1_epi32(2);
+        const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+        const __m256 signS = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30));
+        const __m256 signC = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), two), 30));
+
+        s = _mm256_xor_ps(_mm256_blendv_ps(sr, cr, swap), signS);
+        c = _mm256_xor_ps(_mm256_blendv_ps(cr, sr, swap), signC);
+    }
+
+    SHARK_TARGET_AVX2
+    inline void advanceAVX2(const Streams& f, size_t begin, size_t end, float step)
+    {
+        const __m256 vStep = _mm256_set1_ps(step);
+        const __m256 signBit = _mm256_set1_ps(-0.0f);
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8)
+        {
+            __m256 theta = _mm256_fmadd_ps(_mm256_loadu_ps(f.angularSpeed + i), vStep, _mm256_loadu_ps(f.angle + i));
+            const __m256 turns = _mm256_round_ps(_mm256_mul_ps(theta, _mm256_set1_ps(kInvTwoPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            theta = _mm256_fnmadd_ps(turns, _mm256_set1_ps(kTwoPi), theta);
+
+            __m256 s, c;
+            sincosAVX2(theta, s, c);
+
+            const __m256 r = _mm256_loadu_ps(f.radius + i);
+            _mm256_storeu_ps(f.angle + i, theta);
+            _mm256_storeu_ps(f.posX + i, _mm256_fmadd_ps(r, c, _mm256_loadu_ps(f.centerX + i)));
+            _mm256_storeu_ps(f.posZ + i, _mm256_fmadd_ps(r, s, _mm256_loadu_ps(f.centerZ + i)));
+            _mm256_storeu_ps(f.headingX + i, s);
+            _mm256_storeu_ps(f.headingZ + i, _mm256_xor_ps(c, signBit));
+        }
+        advanceScalar(f, i, end, step);
+    }
+#endif
+
+    using Kernel = void (*)(const Streams&, size_t, size_t, float);
+
+    inline Kernel kernelFor(SimdLevel level)
+    {
+#if defined(SHARK_SIMD_X86)
+        if (level == SimdLevel::kAVX2)  return advanceAVX2;
+        if (level == SimdLevel::kSSE41) return advanceSSE41;
+#endif
+        return advanceScalar;
+    }
+
+    // Advances fish [begin, end) with the best kernel this CPU supports
+    inline void advance(const Streams& f, size_t begin, size_t end, float step)
+    {
+        static const Kernel kernel = kernelFor(cpuSimdLevel());
+        kernel(f, begin, end, step);
+    }
+
+    // Micro-benchmark: runs every supported kernel over fishCount fish and
+    // prints throughput plus the worst deviation from the reference path
+    inline void benchmark(size_t fishCount, int iterations)
+    {
+        std::vector<float> angularSpeed(fishCount), radius(fishCount), centerX(fishCount), centerZ(fishCount);
+        std::vector<float> startAngle(fishCount);
+        for (size_t i = 0; i < fishCount; ++i)
+        {
+            angularSpeed[i] = 0.05f + 0.001f * static_cast<float>(i % 100);
+            radius[i] = 2.0f + static_cast<float>(i % 37) * 0.5f;
+            centerX[i] = static_cast<float>(i % 101) - 50.0f;
+            centerZ[i] = static_cast<float>(i % 103) - 50.0f;
+            startAngle[i] = wrapAngle(static_cast<float>(i) * 0.37f);
+        }
+
+        struct Output
+        {
+            std::vector<float> angle, posX, posZ, headingX, headingZ;
+            explicit Output(size_t n) : angle(n), posX(n), posZ(n), headingX(n), headingZ(n) {}
+            Streams streams(const std::vector<float>& w, const std::vector<float>& r,
+                            const std::vector<float>& cx, const std::vector<float>& cz)
+            {
+                return { angle.data(), posX.data(), posZ.data(), headingX.data(), headingZ.data(),
+                         w.data(), r.data(), cx.data(), cz.data(), angle.size() };
+            }
+        };
+
+        const float step = 1.0f / 60.0f;
+
+        Output reference(fishCount);
+        reference.angle = startAngle;
+        Streams referenceStreams = reference.streams(angularSpeed, radius, centerX, centerZ);
+        advanceReference(referenceStreams, 0, fishCount, step);
+
+        std::vector<SimdLevel> levels = { SimdLevel::kScalar };
+        if (cpuSimdLevel() >= SimdLevel::kSSE41) levels.push_back(SimdLevel::kSSE41);
+        if (cpuSimdLevel() >= SimdLevel::kAVX2)  levels.push_back(SimdLevel::kAVX2);
+
+        std::cout << "Fish motion benchmark: " << fishCount << " fish, " << iterations << " iterations" << std::endl;
+        for (SimdLevel level : levels)
+        {
+            const Kernel kernel = kernelFor(level);
+            Output out(fishCount);
+
+            // Accuracy: one step from the same start as the reference
+            out.angle = startAngle;
+            Streams streams = out.streams(angularSpeed, radius, centerX, centerZ);
+            kernel(streams, 0, fishCount, step);
+
+            float maxPosError = 0.0f;
+            float maxHeadingError = 0.0f;
+            for (size_t i = 0; i < fishCount; ++i)
+            {
+                maxPosError = std::max(maxPosError, std::abs(out.posX[i] - reference.posX[i]) / radius[i]);
+                maxPosError = std::max(maxPosError, std::abs(out.posZ[i] - reference.posZ[i]) / radius[i]);
+                maxHeadingError = std::max(maxHeadingError, std::abs(out.headingX[i] - reference.headingX[i]));
+                maxHeadingError = std::max(maxHeadingError, std::abs(out.headingZ[i] - reference.headingZ[i]));
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            for (int it = 0; it < iterations; ++it)
+                kernel(streams, 0, fishCount, step);
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::cout << "  " << simdLevelName(level) << ": "
+                      << static_cast<double>(fishCount) * iterations / seconds / 1.0e6 << " Mfish/s, "
+                      << seconds * 1000.0 / iterations << " ms/update, "
+                      << "max error pos/radius " << maxPosError << ", heading " << maxHeadingError << std::endl;
+        }
+    }
+}
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include "fish_motion.hpp"
+#include "job_system.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Stable reference to a fish. Dense indices change when other fish are removed;
+// a handle keeps naming the same fish until it is removed, and is never
+// confused with a later fish that reuses its slot.
+struct FishHandle
+{
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool operator==(const FishHandle& other) const { return slot == other.slot && generation == other.generation; }
+    bool operator!=(const FishHandle& other) const { return !(*this == other); }
+};
+
+// Structure-of-arrays store for the fish school.
+//
+// Hot streams are read and written by the per-frame update and collision passes,
+// cold streams are only read when the draw loop builds model matrices. Every
+// stream has size() entries and fish i lives at index i in all of them.
+//
+// Only live fish are stored: remove() moves the last fish into the hole (swap
+// and pop), so [0, size()) is always dense and loops need no alive check. The
+// slot table maps FishHandles to dense indices; add() reuses freed slots, so
+// removal and respawn are both O(1).
+//
+// Iteration API:
+//   advance(dt, k[, jobs])  - circular motion for every fish (update loop)
+//   FlockSimulation::step   - schooling instead of circular motion (flock.hpp)
+//   for i in [0, size())    - every fish is live (collision and draw loops)
+//   grow(n) + set(i, ...)   - bulk spawn, filled in parallel (scenario.hpp)
+//   storePrevious()         - snapshot before a simulation tick
+//   position(i) / modelMatrix(i[, alpha]) - gather helpers for a single fish
+//   handleAt(i) / indexOf(handle) - convert between dense indices and handles
+class FishPool
+{
+public:
+    //// Hot streams ////
+    std::vector<float> posX, posY, posZ;
+    std::vector<float> velX, velY, velZ;  // Only integrated while schooling (FlockSimulation)
+    std::vector<float> angle;
+    std::vector<float> angularSpeed;
+    std::vector<float> radius;          // Orbit radius around (centerX, centerZ)
+    std::vector<float> centerX, centerZ;
+    std::vector<float> boundingRadius;  // Bounding sphere is centred on the position
+    std::vector<float> renderRadius;    // Holds the drawn mesh, see setMeshRadius(); for culling
+
+    //// Cold streams ////
+    std::vector<float> headingX, headingZ; // Unit swim direction in the XZ plane
+    std::vector<glm::vec3> scale;
+
+    // State at the start of the current simulation tick, for interpolated drawing
+    std::vector<float> prevPosX, prevPosY, prevPosZ;
+    std::vector<float> prevHeadingX, prevHeadingZ;
+
+    size_t size() const { return posX.size(); }
+
+    // Upper bound on FishHandle::slot, for side tables indexed by slot
+    size_t slotCount() const { return slots_.size(); }
+
+    void reserve(size_t count)
+    {
+        forEachStream([count](auto& stream) { stream.reserve(count); });
+    }
+
+    // Removes every fish; all outstanding handles become stale
+    void clear()
+    {
+        for (uint32_t slot : slotOf_)
+            releaseSlot(slot);
+        forEachStream([](auto& stream) { stream.clear(); });
+    }
+
+    // Adds a fish orbiting center in the XZ plane, starting at position
+    FishHandle add(const glm::vec3& position, const glm::vec3& fishScale,
+               const glm::vec3& center = glm::vec3(0.0f), float fishAngularSpeed = 0.1f)
+    {
+        const size_t i = grow(1);
+        set(i, position, fishScale, center, fishAngularSpeed);
+        return handleAt(i);
+    }
+
+    // Appends count fish with unset state and returns the index of the first.
+    // Fill them with set(); distinct indices may be set from different threads.
+    size_t grow(size_t count)
+    {
+        const size_t first = size();
+        forEachStream([first, count](auto& stream) { stream.resize(first + count); });
+
+        for (size_t i = first; i < first + count; ++i)
+        {
+            uint32_t slot;
+            if (!freeSlots_.empty())
+            {
+                slot = freeSlots_.back();
+                freeSlots_.pop_back();
+            }
+            else
+            {
+                slot = static_cast<uint32_t>(slots_.size());
+                slots_.push_back(Slot());
+            }
+            slots_[slot].index = static_cast<uint32_t>(i);
+            slotOf_[i] = slot;
+        }
+        return first;
+    }
+
+    // (Re)initialises fish i to orbit center in the XZ plane, starting at position
+    void set(size_t i, const glm::vec3& position, const glm::vec3& fishScale,
+             const glm::vec3& center = glm::vec3(0.0f), float fishAngularSpeed = 0.1f)
+    {
+        const float dx = position.x - center.x;
+        const float dz = position.z - center.z;
+        const float orbitRadius = std::sqrt(dx * dx + dz * dz);
+        const float hx = orbitRadius > 0.0f ? dz / orbitRadius : 0.0f;
+        const float hz = orbitRadius > 0.0f ? -dx / orbitRadius : 1.0f;
+        const float orbitSpeed = glm::max(std::abs(fishAngularSpeed) * orbitRadius, 0.5f);
+
+        posX[i] = position.x;
+        posY[i] = position.y;
+        posZ[i] = position.z;
+        velX[i] = hx * orbitSpeed;
+        velY[i] = 0.0f;
+        velZ[i] = hz * orbitSpeed;
+        angle[i] = FishMotion::atan2Poly(dz, dx);
+        angularSpeed[i] = fishAngularSpeed;
+        radius[i] = orbitRadius;
+        centerX[i] = center.x;
+        centerZ[i] = center.z;
+        boundingRadius[i] = 0.8f * glm::max(fishScale.x, glm::max(fishScale.y, fishScale.z));
+        renderRadius[i] = meshRadius_ * glm::max(fishScale.x, glm::max(fishScale.y, fishScale.z));
+
+        headingX[i] = hx;
+        headingZ[i] = hz;
+        scale[i] = fishScale;
+
+        prevPosX[i] = position.x;
+        prevPosY[i] = position.y;
+        prevPosZ[i] = position.z;
+        prevHeadingX[i] = hx;
+        prevHeadingZ[i] = hz;
+    }
+
+    // Radius of the fish mesh around its origin (Model::boundingRadius), so
+    // renderRadius holds the scaled mesh. The gameplay boundingRadius is
+    // smaller and stays as it is. Rescales the fish already in the pool.
+    void setMeshRadius(float meshRadius)
+    {
+        meshRadius_ = meshRadius;
+        for (size_t i = 0; i < size(); ++i)
+            renderRadius[i] = meshRadius_ * glm::max(scale[i].x, glm::max(scale[i].y, scale[i].z));
+    }
+
+    // Removes fish i by moving the last fish into its place. The moved fish
+    // keeps its handle; only its dense index changes.
+    void removeAt(size_t i)
+    {
+        releaseSlot(slotOf_[i]);
+
+        const size_t last = size() - 1;
+        if (i != last)
+        {
+            forEachStream([i, last](auto& stream) { stream[i] = stream[last]; });
+            slots_[slotOf_[i]].index = static_cast<uint32_t>(i);
+        }
+        forEachStream([](auto& stream) { stream.pop_back(); });
+    }
+
+    // Returns false if the handle is stale (fish already removed)
+    bool remove(FishHandle handle)
+    {
+        const size_t i = indexOf(handle);
+        if (i == npos)
+            return false;
+        removeAt(i);
+        return true;
+    }
+
+    static constexpr size_t npos = SIZE_MAX;
+
+    bool contains(FishHandle handle) const
+    {
+        return indexOf(handle) != npos;
+    }
+
+    // Dense index of the fish, or npos if the handle is stale
+    size_t indexOf(FishHandle handle) const
+    {
+        if (handle.slot >= slots_.size())
+            return npos;
+        const Slot& slot = slots_[handle.slot];
+        if (slot.generation != handle.generation || slot.index == kFreeIndex)
+            return npos;
+        return slot.index;
+    }
+
+    FishHandle handleAt(size_t i) const
+    {
+        const uint32_t slot = slotOf_[i];
+        return { slot, slots_[slot].generation };
+    }
+
+    // Circular motion for every fish
+    void advance(float deltaTime, float speedMultiplier)
+    {
+        FishMotion::advance(motionStreams(), 0, size(), speedMultiplier * deltaTime);
+    }
+
+    // Same, split across the job system
+    void advance(float deltaTime, float speedMultiplier, JobSystem& jobs)
+    {
+        const FishMotion::Streams streams = motionStreams();
+        const float step = speedMultiplier * deltaTime;
+        jobs.parallelFor(0, size(), 16384, [&](size_t begin, size_t end)
+        {
+            FishMotion::advance(streams, begin, end, step);
+        });
+    }
+
+    FishMotion::Streams motionStreams()
+    {
+        return { angle.data(), posX.data(), posZ.data(), headingX.data(), headingZ.data(),
+                 angularSpeed.data(), radius.data(), centerX.data(), centerZ.data(), size() };
+    }
+
+    // Re-derives orbit angle and radius from the current positions, so circular
+    // motion can resume where schooling left the fish
+    void resetOrbits()
+    {
+        const size_t count = size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float dx = posX[i] - centerX[i];
+            const float dz = posZ[i] - centerZ[i];
+            angle[i] = std::atan2(dz, dx);
+            radius[i] = std::sqrt(dx * dx + dz * dz);
+        }
+    }
+
+    // Sets velocities to the current orbit tangent, so schooling starts from
+    // the speed and direction the fish were circling with
+    void resetVelocities()
+    {
+        const size_t count = size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float orbitSpeed = glm::max(std::abs(angularSpeed[i]) * radius[i], 0.5f);
+            velX[i] = headingX[i] * orbitSpeed;
+            velY[i] = 0.0f;
+            velZ[i] = headingZ[i] * orbitSpeed;
+        }
+    }
+
+    // Keeps the current positions and headings as the previous tick's state
+    void storePrevious()
+    {
+        prevPosX = posX;
+        prevPosY = posY;
+        prevPosZ = posZ;
+        prevHeadingX = headingX;
+        prevHeadingZ = headingZ;
+    }
+
+    glm::vec3 position(size_t i) const
+    {
+        return glm::vec3(posX[i], posY[i], posZ[i]);
+    }
+
+    glm::mat4 modelMatrix(size_t i) const
+    {
+        return composeMatrix(glm::vec3(posX[i], posY[i], posZ[i]), headingX[i], headingZ[i], scale[i]);
+    }
+
+    // Model matrix blended between the previous and the current tick
+    glm::mat4 modelMatrix(size_t i, float alpha) const
+    {
+        glm::vec3 position;
+        float hx, hz;
+        pose(i, alpha, position, hx, hz);
+        return composeMatrix(position, hx, hz, scale[i]);
+    }
+
+    // Position and unit heading blended between the previous and the current tick
+    void pose(size_t i, float alpha, glm::vec3& position, float& hx, float& hz) const
+    {
+        hx = prevHeadingX[i] + (headingX[i] - prevHeadingX[i]) * alpha;
+        hz = prevHeadingZ[i] + (headingZ[i] - prevHeadingZ[i]) * alpha;
+        const float length = std::sqrt(hx * hx + hz * hz);
+        if (length > 1e-6f)
+        {
+            hx /= length;
+            hz /= length;
+        }
+        else
+        {
+            hx = headingX[i];
+            hz = headingZ[i];
+        }
+
+        position = glm::vec3(prevPosX[i] + (posX[i] - prevPosX[i]) * alpha,
+                             prevPosY[i] + (posY[i] - prevPosY[i]) * alpha,
+                             prevPosZ[i] + (posZ[i] - prevPosZ[i]) * alpha);
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t index = kFreeIndex;    // Dense index, or kFreeIndex while unused
+        uint32_t generation = 0;        // Bumped on every removal
+    };
+
+    static constexpr uint32_t kFreeIndex = UINT32_MAX;
+
+    void releaseSlot(uint32_t slot)
+    {
+        slots_[slot].index = kFreeIndex;
+        ++slots_[slot].generation;
+        freeSlots_.push_back(slot);
+    }
+
+    // translate * rotateY * scale, with the rotation taken from the heading
+    // vector instead of an angle (yaw = atan2(hx, hz))
+    static glm::mat4 composeMatrix(const glm::vec3& position, float hx, float hz, const glm::vec3& s)
+    {
+        glm::mat4 model(1.0f);
+        model[0] = glm::vec4(hz * s.x, 0.0f, -hx * s.x, 0.0f);
+        model[1] = glm::vec4(0.0f, s.y, 0.0f, 0.0f);
+        model[2] = glm::vec4(hx * s.z, 0.0f, hz * s.z, 0.0f);
+        model[3] = glm::vec4(position, 1.0f);
+        return model;
+    }
+
+    // Applies fn to every stream, so resizing ops can never miss one
+    template <typename Fn>
+    void forEachStream(Fn&& fn)
+    {
+        fn(posX); fn(posY); fn(posZ);
+        fn(velX); fn(velY); fn(velZ);
+        fn(angle);
+        fn(angularSpeed);
+        fn(radius);
+        fn(centerX); fn(centerZ);
+        fn(boundingRadius);
+        fn(renderRadius);
+        fn(headingX); fn(headingZ);
+        fn(scale);
+        fn(prevPosX); fn(prevPosY); fn(prevPosZ);
+        fn(prevHeadingX); fn(prevHeadingZ);
+        fn(slotOf_);
+    }
+
+    float meshRadius_ = 1.0f;
+    std::vector<uint32_t> slotOf_;      // Dense index -> slot, moved along with the streams
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> freeSlots_;
+};
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm.hpp>
+
+#include "fish_pool.hpp"
+#include "gl_state.hpp"
+#include "impostor.hpp"
+#include "job_system.hpp"
+#include "lod.hpp"
+#include "model.hpp"
+#include "render_queue.hpp"
+#include "streaming_buffer.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Per-fish data read by shader/model_instanced.vert at attribute locations 7
+// and 8, see FishImpostors::InstanceFormat. The heading is split across the
+// two w components.
+struct FishInstance
+{
+    glm::vec4 positionHeadingX;
+    glm::vec4 scaleHeadingZ;
+};
+static_assert(FishImpostors::InstanceFormat::stride == sizeof(FishInstance)
+              && FishImpostors::InstanceFormat::offsetOf(8) == offsetof(FishInstance, scaleHeadingZ),
+              "FishImpostors::InstanceFormat must match FishInstance");
+
+// Draws the whole school with one glDrawElementsInstanced per submesh and
+// detail level of the fish model, instead of one Model::Draw per fish.
+// Instance data is written straight into the frame's StreamingBuffer region,
+// grouped by level so each level's instances are one contiguous range.
+//
+// Each fish keeps its level between frames (by handle slot), so the
+// selector's hysteresis applies per fish.
+//
+// With impostors set, fish past impostorFadeEnd are drawn only as impostor
+// quads and fish inside the fade band as both; model.frag and impostor.frag
+// dither complementary pixels across the band.
+//
+//   FishRenderer renderer(lods, streaming);                   // after the GL context exists
+//   renderer.selector = LodSelector::forProjection(fovY, height);
+//   renderer.upload(fishes, alpha, jobs, eye, &visible);       // once per frame
+//   renderer.submit(queue, fishShader.ID, texture, fishModel, object);
+//   renderer.submitImpostors(queue, impostorShader.ID, object);
+class FishRenderer
+{
+public:
+    using InstanceFormat = FishImpostors::InstanceFormat;
+
+    LodSelector selector;           // Set per frame from the projection
+    bool lodEnabled = true;
+
+    const FishImpostors* impostors = nullptr;
+    float impostorFadeStart = 30.0f;    // Fog is about half opaque here
+    float impostorFadeEnd = 36.0f;
+
+    FishRenderer(const LodChain& lods, StreamingBuffer& streaming)
+        : lods_(lods), streaming_(streaming)
+    {
+    }
+
+    FishRenderer(const FishRenderer&) = delete;
+    FishRenderer& operator=(const FishRenderer&) = delete;
+
+    // Packs the interpolated pose of every fish, or only of the fish listed in
+    // visible (dense indices, e.g. from Culling::cullSpheres), into mapped
+    // memory, in parallel. eye is where detail levels are measured from.
+    void upload(const FishPool& fishes, float alpha, JobSystem& jobs, const glm::vec3& eye,
+                const std::vector<uint32_t>* visible = nullptr)
+    {
+        const size_t count = visible ? visible->size() : fishes.size();
+        auto fishAt = [&](size_t k) { return visible ? static_cast<size_t>((*visible)[k]) : k; };
+
+        // Level per instance, carried over per fish for the hysteresis, and
+        // whether it needs a mesh, an impostor or both
+        levelOf_.resize(count);
+        impostorOf_.resize(count);
+        distanceOf_.resize(count);
+        if (slotLevel_.size() < fishes.slotCount())
+            slotLevel_.resize(fishes.slotCount(), 0);
+        jobs.parallelFor(0, count, 8192, [&](size_t begin, size_t end)
+        {
+            for (size_t k = begin; k < end; ++k)
+            {
+                const size_t i = fishAt(k);
+                const glm::vec3 offset = glm::vec3(fishes.posX[i], fishes.posY[i], fishes.posZ[i]) - eye;
+                const float distance = glm::length(offset);
+                distanceOf_[k] = distance;
+
+                // Fade distances are per pixel, so test the nearest and farthest
+                // point of the drawn mesh
+                const float reach = fishes.renderRadius[i];
+                impostorOf_[k] = impostors && distance + reach > impostorFadeStart;
+                if (impostors && distance - reach > impostorFadeEnd)
+                {
+                    levelOf_[k] = kNoMesh;
+                    continue;
+                }
+
+                uint8_t& level = slotLevel_[fishes.handleAt(i).slot];
+                if (lodEnabled)
+                {
+                    const glm::vec3& scale = fishes.scale[i];
+                    level = static_cast<uint8_t>(lods_.select(selector, distance,
+                                                              std::max(scale.x, std::max(scale.y, scale.z)), level));
+                }
+                else
+                {
+                    level = 0;
+                }
+                levelOf_[k] = level;
+            }
+        });
+
+        // Counting sort into the mesh levels and the impostor bucket:
+        // destination slot of every instance in the level-sorted buffer
+        // The nearest fish of each bucket is its depth in the render queue.
+        for (int bucket = 0; bucket < kBuckets; ++bucket)
+        {
+            bucketCount_[bucket] = 0;
+            bucketNearest_[bucket] = std::numeric_limits<float>::max();
+        }
+        for (size_t k = 0; k < count; ++k)
+        {
+            if (levelOf_[k] != kNoMesh)
+            {
+                ++bucketCount_[levelOf_[k]];
+                bucketNearest_[levelOf_[k]] = std::min(bucketNearest_[levelOf_[k]], distanceOf_[k]);
+            }
+            if (impostorOf_[k])
+            {
+                ++bucketCount_[kImpostorBucket];
+                bucketNearest_[kImpostorBucket] = std::min(bucketNearest_[kImpostorBucket], distanceOf_[k]);
+            }
+        }
+        size_t cursor[kBuckets];
+        size_t total = 0;
+        for (int bucket = 0; bucket < kBuckets; ++bucket)
+        {
+            bucketFirst_[bucket] = cursor[bucket] = total;
+            total += bucketCount_[bucket];
+        }
+        destination_.resize(count);
+        impostorDestination_.resize(count);
+        for (size_t k = 0; k < count; ++k)
+        {
+            if (levelOf_[k] != kNoMesh)
+                destination_[k] = static_cast<uint32_t>(cursor[levelOf_[k]]++);
+            if (impostorOf_[k])
+                impostorDestination_[k] = static_cast<uint32_t>(cursor[kImpostorBucket]++);
+        }
+
+        instances_ = streaming_.map(total * sizeof(FishInstance), sizeof(FishInstance));
+        FishInstance* out = static_cast<FishInstance*>(instances_.data);
+        if (out)
+        {
+            jobs.parallelFor(0, count, 8192, [&](size_t begin, size_t end)
+            {
+                for (size_t k = begin; k < end; ++k)
+                {
+                    const size_t i = fishAt(k);
+                    glm::vec3 position;
+                    float hx, hz;
+                    fishes.pose(i, alpha, position, hx, hz);
+                    FishInstance instance;
+                    instance.positionHeadingX = glm::vec4(position, hx);
+                    instance.scaleHeadingZ = glm::vec4(fishes.scale[i], hz);
+                    if (levelOf_[k] != kNoMesh)
+                        out[destination_[k]] = instance;
+                    if (impostorOf_[k])
+                        out[impostorDestination_[k]] = instance;
+                }
+            });
+        }
+        streaming_.unmap();
+        instanceCount_ = out ? total : 0;
+    }
+
+    // Queues one instanced draw per submesh and used level, with the fish
+    // texture and the ObjectConstants at object (the impostor fade band)
+    void submit(RenderQueue& queue, GLuint program, GLuint texture, const Model& model, uint32_t object)
+    {
+        drawCalls_ = 0;
+        triangles_ = 0;
+        if (instanceCount_ == 0)
+            return;
+
+        for (size_t m = 0; m < model.meshes.size(); ++m)
+        {
+            for (int level = 0; level < lods_.levelCount(); ++level)
+            {
+                if (bucketCount_[level] == 0)
+                    continue;
+
+                const LodChain::Range& range = lods_.range(m, level);
+                RenderQueue::DrawItem item;
+                item.program = program;
+                item.textures[0] = texture;
+                item.vao = model.meshes[m].VAO;
+                item.count = static_cast<GLsizei>(range.indexCount);
+                item.first = range.firstIndex;
+                item.instances = static_cast<GLsizei>(bucketCount_[level]);
+                item.object = object;
+                item.prepare = &FishRenderer::prepareBucket;
+                item.context = this;
+                item.argument = static_cast<uint32_t>(level);
+                queue.submit(RenderQueue::kOpaque, item, bucketNearest_[level]);
+                ++drawCalls_;
+                triangles_ += range.indexCount / 3 * bucketCount_[level];
+            }
+        }
+    }
+
+    // Queues one instanced quad per far fish, alpha-tested after the opaque pass
+    void submitImpostors(RenderQueue& queue, GLuint program, uint32_t object)
+    {
+        if (!impostors || instanceCount_ == 0 || bucketCount_[kImpostorBucket] == 0)
+            return;
+
+        RenderQueue::DrawItem item;
+        item.program = program;
+        item.textures[0] = impostors->albedo();
+        item.textures[1] = impostors->normal();
+        item.vao = impostors->vao();
+        item.mode = GL_TRIANGLE_STRIP;
+        item.indexed = false;
+        item.count = 4;
+        item.instances = static_cast<GLsizei>(bucketCount_[kImpostorBucket]);
+        item.object = object;
+        item.prepare = &FishRenderer::prepareBucket;
+        item.context = this;
+        item.argument = kImpostorBucket;
+        queue.submit(RenderQueue::kCutout, item, bucketNearest_[kImpostorBucket]);
+        ++drawCalls_;
+        triangles_ += 2 * bucketCount_[kImpostorBucket];
+    }
+
+    size_t instanceCount() const { return instanceCount_; }
+    size_t instanceCount(int level) const { return bucketCount_[level]; }
+    size_t impostorCount() const { return bucketCount_[kImpostorBucket]; }
+    size_t drawCalls() const { return drawCalls_; }
+    size_t triangles() const { return triangles_; }
+
+private:
+    static constexpr int kImpostorBucket = LodChain::kMaxLevels;
+    static constexpr int kBuckets = LodChain::kMaxLevels + 1;
+    static constexpr uint8_t kNoMesh = UINT8_MAX;
+
+    // RenderQueue hook: the bucket's VAO is bound, point it at the instances
+    static void prepareBucket(const void* context, uint32_t bucket)
+    {
+        const FishRenderer* renderer = static_cast<const FishRenderer*>(context);
+        GlState::current().bindBuffer(GL_ARRAY_BUFFER, renderer->instances_.buffer);
+        renderer->pointInstanceAttributes(static_cast<int>(bucket));
+    }
+
+    // No base instance in GL 3.3, so a bucket's instances are reached by
+    // offsetting the attribute pointers of the bound VAO instead. The arrays
+    // are only enabled here, once they have a buffer: the same mesh VAOs are
+    // drawn without instances by the impostor bake and --no-instancing.
+    void pointInstanceAttributes(int bucket) const
+    {
+        InstanceFormat::setup(instances_.offset + static_cast<GLintptr>(bucketFirst_[bucket] * sizeof(FishInstance)), 1);
+    }
+
+    const LodChain& lods_;
+    StreamingBuffer& streaming_;
+    StreamingBuffer::Allocation instances_;
+    std::vector<uint8_t> slotLevel_;        // Last level of each fish, by handle slot
+    std::vector<uint8_t> levelOf_;          // Per visible fish: mesh level or kNoMesh
+    std::vector<uint8_t> impostorOf_;       // Per visible fish: also drawn as an impostor
+    std::vector<float> distanceOf_;         // Per visible fish: distance from the eye
+    std::vector<uint32_t> destination_;     // Per visible fish: index of its mesh instance
+    std::vector<uint32_t> impostorDestination_;
+    size_t bucketCount_[kBuckets] = {};
+    size_t bucketFirst_[kBuckets] = {};
+    float bucketNearest_[kBuckets] = {};
+    size_t instanceCount_ = 0;
+    size_t drawCalls_ = 0;
+    size_t triangles_ = 0;
+};
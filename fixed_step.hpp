@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+
+// Turns variable frame times into a whole number of fixed simulation ticks.
+//
+//   int ticks = stepper.advance(frameSeconds);
+//   for (int t = 0; t < ticks; ++t) simulation.step(stepper.stepSeconds());
+//   render with stepper.alpha() between the previous and the current tick
+//
+// A frame hitch never produces more than maxCatchUpSteps ticks; the rest of the
+// backlog is dropped, so the simulation slows down instead of spiralling.
+class FixedStepper
+{
+public:
+    explicit FixedStepper(double tickRateHz = 60.0, int maxCatchUpSteps = 5)
+    {
+        setTickRate(tickRateHz);
+        setMaxCatchUpSteps(maxCatchUpSteps);
+    }
+
+    void setTickRate(double tickRateHz)
+    {
+        step_ = 1.0 / std::max(tickRateHz, 1.0);
+    }
+
+    void setMaxCatchUpSteps(int steps)
+    {
+        maxSteps_ = std::max(steps, 1);
+    }
+
+    double stepSeconds() const { return step_; }
+    double tickRate() const { return 1.0 / step_; }
+
+    // Number of ticks to run for a frame that took frameSeconds
+    int advance(double frameSeconds)
+    {
+        accumulator_ += std::max(frameSeconds, 0.0);
+
+        int ticks = static_cast<int>(accumulator_ / step_);
+        if (ticks > maxSteps_)
+        {
+            droppedSeconds_ += accumulator_ - maxSteps_ * step_;
+            ticks = maxSteps_;
+            accumulator_ = maxSteps_ * step_;
+        }
+
+        accumulator_ -= ticks * step_;
+        totalTicks_ += ticks;
+        return ticks;
+    }
+
+    // How far the frame is between the last two ticks, in [0, 1)
+    float alpha() const
+    {
+        return static_cast<float>(accumulator_ / step_);
+    }
+
+    long long totalTicks() const { return totalTicks_; }
+    double droppedSeconds() const { return droppedSeconds_; }
+
+private:
+    double step_ = 1.0 / 60.0;
+    int maxSteps_ = 5;
+    double accumulator_ = 0.0;
+    double droppedSeconds_ = 0.0;   // Simulated time given up to catch-up limits
+    long long totalTicks_ = 0;
+};
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include "fish_pool.hpp"
+#include "job_system.hpp"
+#include "spatial_grid.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Tunable boids parameters. Weights scale the steering terms before the sum is
+// clamped to maxAcceleration.
+struct FlockSettings
+{
+    float neighborRadius = 1.5f;    // Also the spatial hash cell size
+    float separationRadius = 0.6f;
+    int maxNeighbors = 24;          // Caps the work per fish inside dense clumps
+
+    float separationWeight = 1.6f;
+    float alignmentWeight = 1.0f;
+    float cohesionWeight = 0.8f;
+    float fleeWeight = 6.0f;
+    float fleeRadius = 8.0f;        // Fish start fleeing when the shark is this close
+    float boundsWeight = 2.0f;
+
+    // Soft box the school is steered back into
+    glm::vec3 boundsCenter = glm::vec3(0.0f, 3.0f, -13.0f);
+    glm::vec3 boundsHalfExtent = glm::vec3(14.0f, 3.5f, 14.0f);
+
+    float minSpeed = 0.6f;
+    float maxSpeed = 2.0f;
+    float maxAcceleration = 4.0f;
+    float verticalDamping = 0.8f;   // Fraction of vertical speed removed per second
+};
+
+// Timings of the last step() in milliseconds
+struct FlockStats
+{
+    double gridMs = 0.0;
+    double steerMs = 0.0;
+    double integrateMs = 0.0;
+    size_t agents = 0;
+    size_t neighborTests = 0;       // Candidate pairs that were distance-tested
+};
+
+// Boids schooling (separation, alignment, cohesion, flee from the shark) over
+// the FishPool streams. Neighbours come from a SpatialHashGrid rebuilt every tick.
+// A step is three phases, each exposed on its own so callers can split the ranges:
+//   buildGrid -> steer (reads the bucket-ordered copy, writes accelerations)
+//             -> integrate (writes velocities, positions, headings)
+class FlockSimulation
+{
+public:
+    FlockSettings settings;
+
+    const FlockStats& stats() const { return stats_; }
+    const SpatialHashGrid& grid() const { return grid_; }
+
+    // With a job system the gather, steer and integrate phases run in parallel;
+    // the counting sort itself stays serial
+    void step(FishPool& fishes, const glm::vec3& sharkPosition, float deltaTime, float speedMultiplier = 1.0f,
+              JobSystem* jobs = nullptr)
+    {
+        using Clock = std::chrono::steady_clock;
+        const size_t count = fishes.size();
+
+        const auto t0 = Clock::now();
+        buildGrid(fishes, jobs);
+        const auto t1 = Clock::now();
+
+        std::atomic<size_t> tests{ 0 };
+        forRange(jobs, count, [&](size_t begin, size_t end)
+        {
+            tests.fetch_add(steer(sharkPosition, begin, end), std::memory_order_relaxed);
+        });
+        const auto t2 = Clock::now();
+
+        forRange(jobs, count, [&](size_t begin, size_t end)
+        {
+            integrate(fishes, deltaTime, speedMultiplier, begin, end);
+        });
+        const auto t3 = Clock::now();
+
+        stats_.gridMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        stats_.steerMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        stats_.integrateMs = std::chrono::duration<double, std::milli>(t3 - t2).count();
+        stats_.agents = fishes.size();
+        stats_.neighborTests = tests.load();
+    }
+
+    // Builds the grid and gathers positions and velocities into bucket order,
+    // so the neighbours scanned by steer() sit next to each other in memory
+    void buildGrid(const FishPool& fishes, JobSystem* jobs = nullptr)
+    {
+        const size_t count = fishes.size();
+        grid_.build(fishes.posX.data(), fishes.posY.data(), fishes.posZ.data(), count, settings.neighborRadius);
+
+        accX_.resize(count);
+        accY_.resize(count);
+        accZ_.resize(count);
+        sorted_.resize(count);
+
+        const uint32_t* order = grid_.sortedIndices.data();
+        forRange(jobs, count, [&](size_t begin, size_t end)
+        {
+            for (size_t k = begin; k < end; ++k)
+            {
+                const uint32_t i = order[k];
+                SortedAgent& agent = sorted_[k];
+                agent.px = fishes.posX[i]; agent.py = fishes.posY[i]; agent.pz = fishes.posZ[i];
+                agent.vx = fishes.velX[i]; agent.vy = fishes.velY[i]; agent.vz = fishes.velZ[i];
+            }
+        });
+    }
+
+    // Computes accelerations for the fish in bucket-order slots [begin, end) of
+    // the grid built by buildGrid(). Returns the number of neighbour tests.
+    size_t steer(const glm::vec3& sharkPosition, size_t begin, size_t end)
+    {
+        const FlockSettings& s = settings;
+        const float neighborRadius2 = s.neighborRadius * s.neighborRadius;
+        const float separationRadius2 = s.separationRadius * s.separationRadius;
+        const SortedAgent* agents = sorted_.data();
+        const uint32_t* order = grid_.sortedIndices.data();
+        size_t tests = 0;
+
+        for (size_t k = begin; k < end; ++k)
+        {
+            const SortedAgent& self = agents[k];
+            const uint32_t i = order[k];
+            const glm::vec3 p(self.px, self.py, self.pz);
+            const glm::vec3 v(self.vx, self.vy, self.vz);
+            glm::vec3 sumPos(0.0f), sumVel(0.0f), separation(0.0f);
+            int neighbors = 0;
+
+            grid_.forEachBucket(p, s.neighborRadius, [&](uint32_t first, uint32_t last)
+            {
+                for (uint32_t j = first; j < last; ++j)
+                {
+                    ++tests;
+                    const SortedAgent& other = agents[j];
+                    if (j == k)
+                        continue;
+
+                    const glm::vec3 d(other.px - p.x, other.py - p.y, other.pz - p.z);
+                    const float dist2 = glm::dot(d, d);
+                    if (dist2 >= neighborRadius2)
+                        continue;
+
+                    sumPos += glm::vec3(other.px, other.py, other.pz);
+                    sumVel += glm::vec3(other.vx, other.vy, other.vz);
+                    if (dist2 < separationRadius2 && dist2 > 1e-8f)
+                        separation -= d / dist2;
+
+                    if (++neighbors >= s.maxNeighbors)
+                        return false;
+                }
+                return true;
+            });
+
+            glm::vec3 acc(0.0f);
+            if (neighbors > 0)
+            {
+                const float inv = 1.0f / static_cast<float>(neighbors);
+                acc += s.alignmentWeight * (sumVel * inv - v);
+                acc += s.cohesionWeight * (sumPos * inv - p);
+                acc += s.separationWeight * separation;
+            }
+
+            // Flee from the shark, stronger the closer it is
+            const glm::vec3 away = p - sharkPosition;
+            const float sharkDist2 = glm::dot(away, away);
+            if (sharkDist2 < s.fleeRadius * s.fleeRadius && sharkDist2 > 1e-8f)
+            {
+                const float sharkDist = std::sqrt(sharkDist2);
+                acc += s.fleeWeight * s.maxAcceleration * (1.0f - sharkDist / s.fleeRadius) * (away / sharkDist);
+            }
+
+            // Push back into the bounds box in proportion to the overshoot
+            const glm::vec3 offset = p - s.boundsCenter;
+            const glm::vec3 overshoot = glm::max(glm::abs(offset) - s.boundsHalfExtent, glm::vec3(0.0f));
+            acc -= s.boundsWeight * overshoot * glm::sign(offset);
+
+            const float accLength2 = glm::dot(acc, acc);
+            if (accLength2 > s.maxAcceleration * s.maxAcceleration)
+                acc *= s.maxAcceleration / std::sqrt(accLength2);
+
+            accX_[i] = acc.x;
+            accY_[i] = acc.y;
+            accZ_[i] = acc.z;
+        }
+        return tests;
+    }
+
+    // Integrates fish [begin, end) with the accelerations from steer()
+    void integrate(FishPool& fishes, float deltaTime, float speedMultiplier, size_t begin, size_t end)
+    {
+        const FlockSettings& s = settings;
+        const float minSpeed = s.minSpeed * speedMultiplier;
+        const float maxSpeed = s.maxSpeed * speedMultiplier;
+        const float verticalKeep = glm::max(0.0f, 1.0f - s.verticalDamping * deltaTime);
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            glm::vec3 v(fishes.velX[i] + accX_[i] * deltaTime,
+                        (fishes.velY[i] + accY_[i] * deltaTime) * verticalKeep,
+                        fishes.velZ[i] + accZ_[i] * deltaTime);
+
+            const float speed = glm::length(v);
+            if (speed > 1e-6f)
+                v *= glm::clamp(speed, minSpeed, maxSpeed) / speed;
+
+            fishes.velX[i] = v.x;
+            fishes.velY[i] = v.y;
+            fishes.velZ[i] = v.z;
+            fishes.posX[i] += v.x * deltaTime;
+            fishes.posY[i] += v.y * deltaTime;
+            fishes.posZ[i] += v.z * deltaTime;
+
+            const float horizontal = std::sqrt(v.x * v.x + v.z * v.z);
+            if (horizontal > 1e-4f)
+            {
+                fishes.headingX[i] = v.x / horizontal;
+                fishes.headingZ[i] = v.z / horizontal;
+            }
+        }
+    }
+
+private:
+    template <typename Fn>
+    static void forRange(JobSystem* jobs, size_t count, Fn&& fn)
+    {
+        if (jobs)
+            jobs->parallelFor(0, count, 2048, fn);
+        else
+            fn(size_t(0), count);
+    }
+
+    struct SortedAgent
+    {
+        float px, py, pz;
+        float vx, vy, vz;
+    };
+
+    SpatialHashGrid grid_;
+    std::vector<SortedAgent> sorted_;
+    std::vector<float> accX_, accY_, accZ_;
+    FlockStats stats_;
+};
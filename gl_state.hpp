@@ -0,0 +1,357 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <initializer_list>
+#include <iomanip>
+#include <ostream>
+
+// Shadow copy of the GL binding and render state, so a bind or enable that
+// would not change anything is never sent to the driver.
+//
+// Covers the program, the VAO, 2D textures per unit, the generic and indexed
+// buffer bindings and the blend/depth state the renderer touches. Everything
+// starts unknown, so the first call for each piece of state is always issued.
+// Code that changes this state must go through GlState, or call invalidate()
+// afterwards. GL_ELEMENT_ARRAY_BUFFER is VAO state and is not cached.
+//
+// There is one GL context and it is only used from the main thread, so there
+// is one GlState, GlState::current(). Each call counts as issued or elided;
+// endFrame() closes the frame's counters:
+//
+//   GlState& gl = GlState::current();
+//   gl.useProgram(shader.ID);
+//   gl.bindTexture(0, texture);
+//   gl.bindVertexArray(vao);
+//   ...
+//   gl.endFrame();
+class GlState
+{
+public:
+    enum Kind { kProgram, kVertexArray, kTexture, kBuffer, kRenderState, kKindCount };
+
+    static constexpr unsigned kTextureUnits = 16;
+    static constexpr unsigned kUniformBindings = 16;
+
+    struct Counters
+    {
+        uint64_t issued[kKindCount] = {};
+        uint64_t elided[kKindCount] = {};
+
+        uint64_t totalIssued() const { return sum(issued); }
+        uint64_t totalElided() const { return sum(elided); }
+
+        Counters& operator+=(const Counters& other)
+        {
+            for (int k = 0; k < kKindCount; ++k)
+            {
+                issued[k] += other.issued[k];
+                elided[k] += other.elided[k];
+            }
+            return *this;
+        }
+
+    private:
+        static uint64_t sum(const uint64_t (&counts)[kKindCount])
+        {
+            uint64_t total = 0;
+            for (uint64_t count : counts)
+                total += count;
+            return total;
+        }
+    };
+
+    static GlState& current()
+    {
+        static GlState state;
+        return state;
+    }
+
+    GlState(const GlState&) = delete;
+    GlState& operator=(const GlState&) = delete;
+
+    //// Bindings ////
+
+    void useProgram(GLuint program)
+    {
+        if (change(program_, program, kProgram))
+            glUseProgram(program);
+    }
+
+    void bindVertexArray(GLuint vao)
+    {
+        if (change(vertexArray_, vao, kVertexArray))
+            glBindVertexArray(vao);
+    }
+
+    // Binds a 2D texture to unit, selecting the unit only when it has to
+    void bindTexture(unsigned unit, GLuint texture)
+    {
+        if (unit >= kTextureUnits)
+        {
+            activeTexture(unit);
+            count(kTexture, true);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            return;
+        }
+        if (!change(textures_[unit], texture, kTexture))
+            return;
+        activeTexture(unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    void bindBuffer(GLenum target, GLuint buffer)
+    {
+        GLuint* cached = bufferSlot(target);
+        if (!cached)
+        {
+            count(kBuffer, true);
+            glBindBuffer(target, buffer);
+        }
+        else if (change(*cached, buffer, kBuffer))
+        {
+            glBindBuffer(target, buffer);
+        }
+    }
+
+    // glBindBufferRange on GL_UNIFORM_BUFFER, which also sets the generic binding
+    void bindUniformBufferRange(GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+    {
+        genericUniformBuffer_ = buffer;
+        if (index >= kUniformBindings)
+        {
+            count(kBuffer, true);
+            glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+            return;
+        }
+        UniformRange& range = uniformRanges_[index];
+        const bool same = range.buffer == buffer && range.offset == offset && range.size == size;
+        count(kBuffer, !same);
+        if (same)
+            return;
+        range = { buffer, offset, size };
+        glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+    }
+
+    //// Render state ////
+
+    void setEnabled(GLenum capability, bool enabled)
+    {
+        int8_t* cached = capabilitySlot(capability);
+        const int8_t value = enabled ? 1 : 0;
+        if (cached && *cached == value)
+        {
+            count(kRenderState, false);
+            return;
+        }
+        if (cached)
+            *cached = value;
+        count(kRenderState, true);
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    void enable(GLenum capability) { setEnabled(capability, true); }
+    void disable(GLenum capability) { setEnabled(capability, false); }
+
+    // Cached if known, otherwise asked of GL (and remembered)
+    bool isEnabled(GLenum capability)
+    {
+        int8_t* cached = capabilitySlot(capability);
+        if (cached && *cached != kUnknownFlag)
+            return *cached == 1;
+        const bool enabled = glIsEnabled(capability) == GL_TRUE;
+        if (cached)
+            *cached = enabled ? 1 : 0;
+        return enabled;
+    }
+
+    void blendFunc(GLenum source, GLenum destination)
+    {
+        const bool same = blendSource_ == source && blendDestination_ == destination;
+        count(kRenderState, !same);
+        if (same)
+            return;
+        blendSource_ = source;
+        blendDestination_ = destination;
+        glBlendFunc(source, destination);
+    }
+
+    void depthFunc(GLenum function)
+    {
+        if (change(depthFunc_, function, kRenderState))
+            glDepthFunc(function);
+    }
+
+    void depthMask(bool write)
+    {
+        const int8_t value = write ? 1 : 0;
+        count(kRenderState, depthMask_ != value);
+        if (depthMask_ == value)
+            return;
+        depthMask_ = value;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    //// Bookkeeping ////
+
+    // Forget everything, e.g. after code that changes GL state directly
+    void invalidate()
+    {
+        program_ = kUnknown;
+        vertexArray_ = kUnknown;
+        activeUnit_ = kUnknown;
+        for (GLuint& texture : textures_)
+            texture = kUnknown;
+        arrayBuffer_ = copyReadBuffer_ = copyWriteBuffer_ = genericUniformBuffer_ = kUnknown;
+        for (UniformRange& range : uniformRanges_)
+            range = UniformRange();
+        blend_ = depthTest_ = cullFace_ = depthMask_ = kUnknownFlag;
+        blendSource_ = blendDestination_ = depthFunc_ = kUnknown;
+    }
+
+    // Deleting an object unbinds it, and GL may hand its name out again
+    void forgetBuffer(GLuint buffer)
+    {
+        for (GLuint* cached : { &arrayBuffer_, &copyReadBuffer_, &copyWriteBuffer_, &genericUniformBuffer_ })
+        {
+            if (*cached == buffer)
+                *cached = kUnknown;
+        }
+        for (UniformRange& range : uniformRanges_)
+        {
+            if (range.buffer == buffer)
+                range = UniformRange();
+        }
+    }
+
+    void forgetTexture(GLuint texture)
+    {
+        for (GLuint& cached : textures_)
+        {
+            if (cached == texture)
+                cached = kUnknown;
+        }
+    }
+
+    void forgetVertexArray(GLuint vao)
+    {
+        if (vertexArray_ == vao)
+            vertexArray_ = kUnknown;
+    }
+
+    // Closes the frame's counters and adds them to the totals
+    void endFrame()
+    {
+        lastFrame_ = frame_;
+        totals_ += frame_;
+        frame_ = Counters();
+        ++frames_;
+    }
+
+    const Counters& lastFrame() const { return lastFrame_; }
+
+    void printStats(std::ostream& out) const
+    {
+        static const char* const names[kKindCount] = { "program", "vao", "texture", "buffer", "render state" };
+        const double n = frames_ > 0 ? static_cast<double>(frames_) : 1.0;
+        const uint64_t all = totals_.totalIssued() + totals_.totalElided();
+        out << "GL state: " << std::fixed << std::setprecision(1)
+            << totals_.totalIssued() / n << " calls issued, " << totals_.totalElided() / n << " elided per frame ("
+            << (all > 0 ? 100.0 * totals_.totalElided() / all : 0.0) << "% elided)" << std::endl;
+        for (int k = 0; k < kKindCount; ++k)
+            out << "  " << std::left << std::setw(13) << names[k] << std::right << std::setw(9) << totals_.issued[k] / n
+                << " issued " << std::setw(9) << totals_.elided[k] / n << " elided" << std::endl;
+        out << std::defaultfloat;
+    }
+
+private:
+    static constexpr GLuint kUnknown = 0xFFFFFFFFu;
+    static constexpr int8_t kUnknownFlag = -1;
+
+    struct UniformRange
+    {
+        GLuint buffer = kUnknown;
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;
+    };
+
+    GlState()
+    {
+        invalidate();
+    }
+
+    void count(Kind kind, bool issued)
+    {
+        if (issued)
+            ++frame_.issued[kind];
+        else
+            ++frame_.elided[kind];
+    }
+
+    // Stores value and returns true if it differs from the cached one
+    bool change(GLuint& cached, GLuint value, Kind kind)
+    {
+        const bool changed = cached != value;
+        count(kind, changed);
+        cached = value;
+        return changed;
+    }
+
+    // Not counted: only ever issued as part of a texture bind
+    void activeTexture(unsigned unit)
+    {
+        if (activeUnit_ == unit)
+            return;
+        activeUnit_ = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    GLuint* bufferSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER: return &arrayBuffer_;
+        case GL_COPY_READ_BUFFER: return &copyReadBuffer_;
+        case GL_COPY_WRITE_BUFFER: return &copyWriteBuffer_;
+        case GL_UNIFORM_BUFFER: return &genericUniformBuffer_;
+        default: return nullptr;
+        }
+    }
+
+    int8_t* capabilitySlot(GLenum capability)
+    {
+        switch (capability)
+        {
+        case GL_BLEND: return &blend_;
+        case GL_DEPTH_TEST: return &depthTest_;
+        case GL_CULL_FACE: return &cullFace_;
+        default: return nullptr;
+        }
+    }
+
+    GLuint program_ = kUnknown;
+    GLuint vertexArray_ = kUnknown;
+    GLuint activeUnit_ = kUnknown;
+    GLuint textures_[kTextureUnits];
+    GLuint arrayBuffer_ = kUnknown;
+    GLuint copyReadBuffer_ = kUnknown;
+    GLuint copyWriteBuffer_ = kUnknown;
+    GLuint genericUniformBuffer_ = kUnknown;
+    UniformRange uniformRanges_[kUniformBindings];
+    int8_t blend_ = kUnknownFlag;
+    int8_t depthTest_ = kUnknownFlag;
+    int8_t cullFace_ = kUnknownFlag;
+    int8_t depthMask_ = kUnknownFlag;
+    GLenum blendSource_ = kUnknown;
+    GLenum blendDestination_ = kUnknown;
+    GLenum depthFunc_ = kUnknown;
+
+    Counters frame_;
+    Counters lastFrame_;
+    Counters totals_;
+    uint64_t frames_ = 0;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include "fish_pool.hpp"
+#include "job_system.hpp"
+#include "scenario.hpp"
+#include "simulation.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+
+// Simulation-only runs for capacity planning: no window, no GL context, just
+// fish motion, shark steering and the hunt logic at a fixed tick rate.
+struct HeadlessOptions
+{
+    long long ticks = 1000;
+    double tickRate = 60.0;
+    bool schooling = true;
+    bool respawn = false;           // Keep the fish count constant over long runs
+    ScenarioSettings scenario = defaultScenario();
+
+    // 10k fish in schools of 1000 spread over the flock bounds box
+    static ScenarioSettings defaultScenario()
+    {
+        const FlockSettings flock;
+        ScenarioSettings scenario;
+        scenario.center = flock.boundsCenter;
+        scenario.halfExtent = flock.boundsHalfExtent;
+        scenario.fishSpacing = 0.6f;
+        scenario.splitFish(10000);
+        return scenario;
+    }
+};
+
+// Runs options.ticks fixed steps and prints throughput and the average time
+// spent in each phase. Returns the number of fish eaten.
+inline size_t runHeadless(const HeadlessOptions& options, JobSystem& jobs, std::ostream& out)
+{
+    Simulation sim(jobs);
+    sim.schoolingEnabled = options.schooling;
+    sim.respawnEaten = options.respawn;
+
+    using Clock = std::chrono::steady_clock;
+    const auto generateStart = Clock::now();
+    Scenario::generate(options.scenario, sim.fishes, jobs);
+    const double generateMs = std::chrono::duration<double, std::milli>(Clock::now() - generateStart).count();
+
+    // Schooling keeps the fish in the box they were generated in
+    sim.flock.settings.boundsCenter = options.scenario.center;
+    sim.flock.settings.boundsHalfExtent = Scenario::fitHalfExtent(options.scenario);
+
+    // Start the shark at the edge of the school, swimming into it
+    const FlockSettings& settings = sim.flock.settings;
+    sim.shark.position = settings.boundsCenter - glm::vec3(settings.boundsHalfExtent.x, 0.0f, 0.0f);
+    sim.shark.directionAngle = 0.0f;
+    sim.shark.pitchAngle = 0.0f;
+    jobs.resetStats();
+
+    const float stepSeconds = static_cast<float>(1.0 / std::max(options.tickRate, 1.0));
+    SimStats total;
+    double gridMs = 0.0, steerMs = 0.0, integrateMs = 0.0;
+
+    const auto start = Clock::now();
+    for (long long t = 0; t < options.ticks; ++t)
+    {
+        // Scripted weave so the shark sweeps across the school
+        SimInput input;
+        input.turn = std::sin(static_cast<float>(sim.time) * 0.25f) > 0.0f ? 1.0f : -1.0f;
+
+        sim.step(stepSeconds, input);
+
+        const SimStats& s = sim.stats();
+        total.inputMs += s.inputMs;
+        total.fishMs += s.fishMs;
+        total.huntMs += s.huntMs;
+        total.sharkMs += s.sharkMs;
+        if (sim.schoolingEnabled)
+        {
+            gridMs += sim.flock.stats().gridMs;
+            steerMs += sim.flock.stats().steerMs;
+            integrateMs += sim.flock.stats().integrateMs;
+        }
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    const double ticks = static_cast<double>(std::max(options.ticks, 1LL));
+    out << "Headless: " << options.scenario.fishCount() << " fish in " << options.scenario.schoolCount
+        << " school(s), seed " << options.scenario.seed << ", " << options.ticks << " ticks at "
+        << options.tickRate << " Hz, " << jobs.threadCount() << " thread(s), "
+        << (options.schooling ? "schooling" : "orbits") << std::endl;
+    out << std::fixed << std::setprecision(1) << "  scenario generated in " << generateMs << " ms" << std::endl;
+    out << std::fixed << std::setprecision(1)
+        << "  " << options.ticks / std::max(seconds, 1e-9) << " ticks/s, "
+        << options.ticks * stepSeconds / std::max(seconds, 1e-9) << "x real time, "
+        << sim.fishEaten << " fish eaten, " << sim.fishes.size() << " left" << std::endl;
+    out << std::setprecision(3)
+        << "  per tick: input " << total.inputMs / ticks << " ms, fish " << total.fishMs / ticks
+        << " ms, hunt " << total.huntMs / ticks << " ms, shark " << total.sharkMs / ticks << " ms" << std::endl;
+    if (options.schooling)
+    {
+        out << "  flock:    grid " << gridMs / ticks << " ms, steer " << steerMs / ticks
+            << " ms, integrate " << integrateMs / ticks << " ms" << std::endl;
+    }
+    const FishBroadphase::Stats& broadphase = sim.broadphase.stats();
+    out << "  broadphase: " << std::setprecision(1)
+        << static_cast<double>(broadphase.candidates) / std::max<double>(static_cast<double>(broadphase.queries), 1.0)
+        << " candidates/query, " << broadphase.rebuilds << " rebuilds" << std::endl;
+    out << std::defaultfloat;
+    jobs.printStats(out);
+    return sim.fishEaten;
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include "gl_state.hpp"
+#include "model.hpp"
+#include "shader.hpp"
+#include "streaming_buffer.hpp"
+#include "uniform_blocks.hpp"
+#include "vertex_layout.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <limits>
+
+// Octahedral impostors for far-away fish.
+//
+// At startup the fish model is rendered from framesPerSide^2 directions into
+// an atlas: cell (x, y) holds the view from octDecode of the cell's centre, so
+// directions are spread evenly over the whole sphere. Two layers are baked,
+// albedo (with coverage in alpha) and the mesh-space normal, so far fish are
+// lit and fogged at draw time exactly like the meshes.
+//
+// Each far fish is then one instanced quad (shader/impostor.vert) that picks
+// the cell closest to its view direction. The quads read the same FishInstance
+// data as shader/model_instanced.vert; FishRenderer draws them.
+class FishImpostors
+{
+public:
+    // Per-fish instance data, FishInstance in fish_renderer.hpp; FishRenderer
+    // points these attributes at each frame's instances
+    using InstanceFormat = VertexLayout::Format<
+        VertexLayout::Attribute<7, float, 4>,       // Position, heading x
+        VertexLayout::Attribute<8, float, 4>>;      // Scale, heading z
+
+    // bakeShader: shader/impostor_bake.vert + .frag; diffuse: the fish texture.
+    // Each view's camera goes through the FrameConstants block in streaming.
+    // Construct before FishRenderer draws, which adds instance attributes to
+    // the mesh VAOs that a plain draw cannot source.
+    FishImpostors(const Model& model, Shader& bakeShader, StreamingBuffer& streaming, GLuint diffuse,
+                  int framesPerSide = 12, int frameSize = 96)
+        : framesPerSide_(framesPerSide), frameSize_(frameSize)
+    {
+        computeBounds(model);
+        createTargets();
+        bake(model, bakeShader, streaming, diffuse);
+
+        // Quads are expanded from gl_VertexID; the VAO only carries the instance attributes
+        glGenVertexArrays(1, &vao_);
+        GlState::current().bindVertexArray(vao_);
+        InstanceFormat::enable(1);
+
+        std::cout << "Fish impostors: " << framesPerSide_ * framesPerSide_ << " views of " << frameSize_ << " px, "
+                  << atlasSize() << "x" << atlasSize() << " atlas" << std::endl;
+    }
+
+    ~FishImpostors()
+    {
+        GlState& gl = GlState::current();
+        gl.forgetVertexArray(vao_);
+        gl.forgetTexture(albedo_);
+        gl.forgetTexture(normal_);
+        glDeleteVertexArrays(1, &vao_);
+        glDeleteTextures(1, &albedo_);
+        glDeleteTextures(1, &normal_);
+    }
+
+    FishImpostors(const FishImpostors&) = delete;
+    FishImpostors& operator=(const FishImpostors&) = delete;
+
+    // Points shader/impostor.vert + .frag at the atlas. Uniforms are program
+    // state, so this runs once, with the shader in use.
+    void configure(Shader& shader) const
+    {
+        shader.uniform<int>("impostorAlbedo").set(0);
+        shader.uniform<int>("impostorNormal").set(1);
+        shader.uniform<glm::vec3>("boundsCenter").set(boundsCenter_);
+        shader.uniform<float>("boundsRadius").set(boundsRadius_);
+        shader.uniform<int>("framesPerSide").set(framesPerSide_);
+    }
+
+    // Quads are expanded from gl_VertexID: draw 4 vertices as a triangle strip
+    // per instance, with FishInstance attributes pointed at locations 7 and 8
+    GLuint vao() const { return vao_; }
+
+    // Atlas layers, for texture units 0 and 1 as set by configure()
+    GLuint albedo() const { return albedo_; }
+    GLuint normal() const { return normal_; }
+
+    float boundsRadius() const { return boundsRadius_; }
+    int atlasSize() const { return framesPerSide_ * frameSize_; }
+
+    // Octahedral mapping between unit directions and [-1, 1]^2, with +y at
+    // the centre; must match the GLSL in shader/impostor.vert
+    static glm::vec2 octEncode(glm::vec3 n)
+    {
+        n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        glm::vec2 p(n.x, n.z);
+        if (n.y < 0.0f)
+            p = (glm::vec2(1.0f) - glm::abs(glm::vec2(p.y, p.x))) * signNotZero(p);
+        return p;
+    }
+
+    static glm::vec3 octDecode(const glm::vec2& p)
+    {
+        glm::vec3 n(p.x, 1.0f - std::abs(p.x) - std::abs(p.y), p.y);
+        if (n.y < 0.0f)
+        {
+            const glm::vec2 folded = (glm::vec2(1.0f) - glm::abs(glm::vec2(n.z, n.x))) * signNotZero(glm::vec2(n.x, n.z));
+            n.x = folded.x;
+            n.z = folded.y;
+        }
+        return glm::normalize(n);
+    }
+
+private:
+    static glm::vec2 signNotZero(const glm::vec2& v)
+    {
+        return glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    void computeBounds(const Model& model)
+    {
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+        for (const Mesh& mesh : model.meshes)
+        {
+            for (const Vertex& vertex : mesh.vertices)
+            {
+                boundsMin = glm::min(boundsMin, vertex.Position);
+                boundsMax = glm::max(boundsMax, vertex.Position);
+            }
+        }
+        boundsCenter_ = 0.5f * (boundsMin + boundsMax);
+        boundsRadius_ = 0.0f;
+        for (const Mesh& mesh : model.meshes)
+        {
+            for (const Vertex& vertex : mesh.vertices)
+                boundsRadius_ = std::max(boundsRadius_, glm::length(vertex.Position - boundsCenter_));
+        }
+    }
+
+    void createTargets()
+    {
+        const int size = atlasSize();
+        GlState& gl = GlState::current();
+        for (GLuint* texture : { &albedo_, &normal_ })
+        {
+            glGenTextures(1, texture);
+            gl.bindTexture(0, *texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        gl.bindTexture(0, 0);
+    }
+
+    void bake(const Model& model, Shader& bakeShader, StreamingBuffer& streaming, GLuint diffuse)
+    {
+        const int size = atlasSize();
+        GlState& gl = GlState::current();
+
+        GLuint framebuffer, depth;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo_, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal_, 0);
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        const GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "Fish impostor framebuffer is incomplete!" << std::endl;
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        const bool blend = gl.isEnabled(GL_BLEND);
+        gl.disable(GL_BLEND);
+
+        // Uncovered texels stay transparent. The cells share the depth buffer,
+        // but their viewports never overlap, so one clear covers them all.
+        glViewport(0, 0, size, size);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        bakeShader.use();
+        gl.bindTexture(0, diffuse);
+        bakeShader.uniform<int>("texture_diffuse").set(0);
+
+        const float r = boundsRadius_;
+        UniformBlocks::FrameConstants camera = {};
+        camera.projection = glm::ortho(-r, r, -r, r, r, 3.0f * r);
+        for (int y = 0; y < framesPerSide_; ++y)
+        {
+            for (int x = 0; x < framesPerSide_; ++x)
+            {
+                const glm::vec2 cell((x + 0.5f) / framesPerSide_, (y + 0.5f) / framesPerSide_);
+                const glm::vec3 direction = octDecode(cell * 2.0f - 1.0f);
+                const glm::vec3 up = std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                camera.viewPos = boundsCenter_ + 2.0f * r * direction;
+                camera.view = glm::lookAt(camera.viewPos, boundsCenter_, up);
+                UniformBlocks::upload(streaming, camera);
+
+                glViewport(x * frameSize_, y * frameSize_, frameSize_, frameSize_);
+                for (const Mesh& mesh : model.meshes)
+                {
+                    gl.bindVertexArray(mesh.VAO);
+                    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(mesh.indices.size()), GL_UNSIGNED_INT, 0);
+                }
+            }
+        }
+
+        // Fence the camera uploads like any frame's, so their region is not
+        // rewritten while the bake may still be reading it
+        streaming.endFrame();
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteRenderbuffers(1, &depth);
+        glDeleteFramebuffers(1, &framebuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        gl.setEnabled(GL_BLEND, blend);
+
+        for (GLuint texture : { albedo_, normal_ })
+        {
+            gl.bindTexture(0, texture);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        gl.bindTexture(0, 0);
+    }
+
+    int framesPerSide_;
+    int frameSize_;
+    glm::vec3 boundsCenter_ = glm::vec3(0.0f);
+    float boundsRadius_ = 0.0f;
+    GLuint albedo_ = 0;
+    GLuint normal_ = 0;
+    GLuint vao_ = 0;
+};
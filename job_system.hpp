@@ -0,0 +1,375 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// A set of jobs with "runs before" edges. Build it once, run it as often as
+// needed with JobSystem::run(); a node starts as soon as all its predecessors
+// have finished.
+class JobGraph
+{
+public:
+    using NodeId = size_t;
+
+    NodeId add(std::function<void()> fn)
+    {
+        nodes_.emplace_back();
+        nodes_.back().fn = std::move(fn);
+        return nodes_.size() - 1;
+    }
+
+    // after will not start until before has finished
+    void precede(NodeId before, NodeId after)
+    {
+        nodes_[before].successors.push_back(after);
+        ++nodes_[after].dependencies;
+    }
+
+    size_t size() const { return nodes_.size(); }
+
+private:
+    friend class JobSystem;
+
+    struct Node
+    {
+        std::function<void()> fn;
+        std::vector<NodeId> successors;
+        int dependencies = 0;
+        std::atomic<int> remaining{ 0 };
+        JobGraph* graph = nullptr;
+    };
+
+    std::deque<Node> nodes_;
+    std::atomic<size_t>* pending_ = nullptr;
+};
+
+// Work-stealing thread pool. Every thread owns a deque: it pushes and pops its
+// own jobs at the back and steals from the front of the others. The thread that
+// created the pool is worker 0 and helps out while it waits, so a pool of N
+// threads starts N - 1 background workers.
+class JobSystem
+{
+public:
+    struct WorkerStats
+    {
+        double busyMs = 0.0;    // Running jobs
+        double idleMs = 0.0;    // Looking for or waiting for work
+        uint64_t jobs = 0;
+        uint64_t steals = 0;
+    };
+
+    // threadCount == 0 picks std::thread::hardware_concurrency()
+    explicit JobSystem(unsigned threadCount = 0)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+        workers_.reserve(threadCount);
+        for (unsigned i = 0; i < threadCount; ++i)
+            workers_.push_back(std::make_unique<Worker>());
+
+        currentWorker() = 0;
+        for (unsigned i = 1; i < threadCount; ++i)
+            threads_.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_)
+            thread.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    unsigned threadCount() const { return static_cast<unsigned>(workers_.size()); }
+
+    // Calls fn(chunkBegin, chunkEnd) over [begin, end) in chunks of about grain
+    // indices and returns once every chunk has run.
+    template <typename Fn>
+    void parallelFor(size_t begin, size_t end, size_t grain, Fn&& fn)
+    {
+        if (end <= begin)
+            return;
+
+        const size_t count = end - begin;
+        grain = std::max<size_t>(grain, 1);
+        if (threadCount() == 1 || count <= grain)
+        {
+            fn(begin, end);
+            return;
+        }
+
+        // No point in making many more chunks than threads can steal
+        const size_t maxChunks = static_cast<size_t>(threadCount()) * 8;
+        const size_t chunks = std::min((count + grain - 1) / grain, maxChunks);
+        const size_t chunkSize = (count + chunks - 1) / chunks;
+
+        using Body = typename std::decay<Fn>::type;
+        std::atomic<size_t> pending{ chunks };
+        for (size_t c = 0; c < chunks; ++c)
+        {
+            const size_t chunkBegin = begin + c * chunkSize;
+            const size_t chunkEnd = std::min(end, chunkBegin + chunkSize);
+            Job job;
+            job.invoke = [](void* context, size_t b, size_t e) { (*static_cast<Body*>(context))(b, e); };
+            job.context = const_cast<void*>(static_cast<const void*>(&fn));
+            job.begin = chunkBegin;
+            job.end = chunkEnd;
+            job.pending = &pending;
+            push(job);
+        }
+        waitFor(pending);
+    }
+
+    // Runs every node of the graph, respecting its edges, and returns when all are done
+    void run(JobGraph& graph)
+    {
+        if (graph.nodes_.empty())
+            return;
+
+        std::atomic<size_t> pending{ graph.nodes_.size() };
+        graph.pending_ = &pending;
+        for (auto& node : graph.nodes_)
+        {
+            node.remaining.store(node.dependencies, std::memory_order_relaxed);
+            node.graph = &graph;
+        }
+        for (auto& node : graph.nodes_)
+        {
+            if (node.dependencies == 0)
+                push(graphJob(node));
+        }
+        waitFor(pending);
+        graph.pending_ = nullptr;
+    }
+
+    std::vector<WorkerStats> stats() const
+    {
+        std::vector<WorkerStats> result(workers_.size());
+        for (size_t i = 0; i < workers_.size(); ++i)
+        {
+            const Worker& w = *workers_[i];
+            result[i].busyMs = static_cast<double>(w.busyNs.load(std::memory_order_relaxed)) * 1e-6;
+            result[i].idleMs = static_cast<double>(w.idleNs.load(std::memory_order_relaxed)) * 1e-6;
+            result[i].jobs = w.jobs.load(std::memory_order_relaxed);
+            result[i].steals = w.steals.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    void resetStats()
+    {
+        for (auto& w : workers_)
+        {
+            w->busyNs = 0;
+            w->idleNs = 0;
+            w->jobs = 0;
+            w->steals = 0;
+        }
+    }
+
+    void printStats(std::ostream& out) const
+    {
+        const std::vector<WorkerStats> all = stats();
+        double busyTotal = 0.0;
+        out << "Job system: " << all.size() << " thread(s)" << std::endl;
+        for (size_t i = 0; i < all.size(); ++i)
+        {
+            const WorkerStats& s = all[i];
+            const double total = s.busyMs + s.idleMs;
+            busyTotal += s.busyMs;
+            out << "  worker " << std::setw(2) << i << ": busy " << std::fixed << std::setprecision(2) << s.busyMs
+                << " ms, idle " << s.idleMs << " ms (" << std::setprecision(1)
+                << (total > 0.0 ? 100.0 * s.busyMs / total : 0.0) << "% busy), "
+                << s.jobs << " jobs, " << s.steals << " steals" << std::endl;
+        }
+        out << "  total busy " << std::setprecision(2) << busyTotal << " ms" << std::defaultfloat << std::endl;
+    }
+
+private:
+    struct Job
+    {
+        void (*invoke)(void* context, size_t begin, size_t end) = nullptr;
+        void* context = nullptr;
+        size_t begin = 0;
+        size_t end = 0;
+        std::atomic<size_t>* pending = nullptr;
+        bool graphNode = false;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Job> queue;
+        std::atomic<uint64_t> busyNs{ 0 };
+        std::atomic<uint64_t> idleNs{ 0 };
+        std::atomic<uint64_t> jobs{ 0 };
+        std::atomic<uint64_t> steals{ 0 };
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    static int& currentWorker()
+    {
+        thread_local int index = 0;
+        return index;
+    }
+
+    static uint64_t elapsedNs(Clock::time_point since)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count());
+    }
+
+    Job graphJob(JobGraph::Node& node)
+    {
+        Job job;
+        job.invoke = [](void* context, size_t, size_t)
+        {
+            JobGraph::Node& self = *static_cast<JobGraph::Node*>(context);
+            self.fn();
+        };
+        job.context = &node;
+        job.pending = node.graph->pending_;
+        job.graphNode = true;
+        return job;
+    }
+
+    void push(const Job& job)
+    {
+        Worker& self = *workers_[currentWorker()];
+        {
+            std::lock_guard<std::mutex> lock(self.mutex);
+            self.queue.push_back(job);
+        }
+        {
+            // Under the sleep lock, so a worker cannot miss this between its check and its wait
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            queued_.fetch_add(1, std::memory_order_release);
+        }
+        wake_.notify_one();
+    }
+
+    bool popOrSteal(int index, Job& out)
+    {
+        Worker& self = *workers_[index];
+        {
+            std::lock_guard<std::mutex> lock(self.mutex);
+            if (!self.queue.empty())
+            {
+                out = self.queue.back();
+                self.queue.pop_back();
+                queued_.fetch_sub(1, std::memory_order_acq_rel);
+                return true;
+            }
+        }
+
+        const size_t count = workers_.size();
+        for (size_t k = 1; k < count; ++k)
+        {
+            Worker& victim = *workers_[(index + k) % count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.queue.empty())
+            {
+                out = victim.queue.front();
+                victim.queue.pop_front();
+                queued_.fetch_sub(1, std::memory_order_acq_rel);
+                self.steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void execute(int index, const Job& job)
+    {
+        Worker& self = *workers_[index];
+        const Clock::time_point start = Clock::now();
+
+        job.invoke(job.context, job.begin, job.end);
+
+        // Graph nodes release their successors before counting themselves done
+        if (job.graphNode)
+        {
+            JobGraph::Node& node = *static_cast<JobGraph::Node*>(job.context);
+            for (JobGraph::NodeId next : node.successors)
+            {
+                JobGraph::Node& successor = node.graph->nodes_[next];
+                if (successor.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    push(graphJob(successor));
+            }
+        }
+
+        self.busyNs.fetch_add(elapsedNs(start), std::memory_order_relaxed);
+        self.jobs.fetch_add(1, std::memory_order_relaxed);
+        job.pending->fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    // Runs jobs on the calling thread until pending drops to zero
+    void waitFor(std::atomic<size_t>& pending)
+    {
+        const int index = currentWorker();
+        Job job;
+        while (pending.load(std::memory_order_acquire) != 0)
+        {
+            if (popOrSteal(index, job))
+            {
+                execute(index, job);
+                continue;
+            }
+            const Clock::time_point start = Clock::now();
+            std::this_thread::yield();
+            workers_[index]->idleNs.fetch_add(elapsedNs(start), std::memory_order_relaxed);
+        }
+    }
+
+    void workerLoop(int index)
+    {
+        currentWorker() = index;
+        Job job;
+        for (;;)
+        {
+            if (popOrSteal(index, job))
+            {
+                execute(index, job);
+                continue;
+            }
+
+            const Clock::time_point start = Clock::now();
+            {
+                std::unique_lock<std::mutex> lock(sleepMutex_);
+                wake_.wait(lock, [this] { return stopping_ || queued_.load(std::memory_order_acquire) > 0; });
+            }
+            workers_[index]->idleNs.fetch_add(elapsedNs(start), std::memory_order_relaxed);
+            if (stopping_)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    std::atomic<int> queued_{ 0 };
+    std::atomic<bool> stopping_{ false };
+};
@@ -0,0 +1,446 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm.hpp>
+
+#include "gl_state.hpp"
+#include "mesh_optimizer.hpp"
+#include "model.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Load-time level-of-detail generation (quadric error metric edge collapse)
+// and per-instance level selection.
+//
+// Simplification only rewrites the index buffer: every collapse moves a vertex
+// onto one of its neighbours (half-edge collapse), so all levels share the
+// mesh's vertex buffer and VAO and a level is just another index range.
+namespace MeshLod
+{
+    // Symmetric 4x4 error quadric plus the weight it was built from, so the
+    // error reads as a mean squared distance whatever the triangle sizes
+    struct Quadric
+    {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+        double a11 = 0, a12 = 0, a13 = 0;
+        double a22 = 0, a23 = 0;
+        double a33 = 0;
+        double weight = 0;
+
+        void addPlane(const glm::dvec3& n, double d, double w)
+        {
+            a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+            a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+            a22 += w * n.z * n.z; a23 += w * n.z * d;
+            a33 += w * d * d;
+            weight += w;
+        }
+
+        Quadric& operator+=(const Quadric& q)
+        {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+            a11 += q.a11; a12 += q.a12; a13 += q.a13;
+            a22 += q.a22; a23 += q.a23;
+            a33 += q.a33;
+            weight += q.weight;
+            return *this;
+        }
+
+        // Mean squared distance of p to the accumulated planes
+        double error(const glm::vec3& p) const
+        {
+            const double x = p.x, y = p.y, z = p.z;
+            const double e = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                           + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                           + a22 * z * z + 2 * a23 * z
+                           + a33;
+            return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+        }
+    };
+
+    enum VertexKind : uint8_t
+    {
+        kManifold,      // Free to collapse onto any neighbour
+        kBorder,        // On an open edge; only slides along the border
+        kLocked         // Shares its position with a vertex of other attributes (UV seam)
+    };
+
+    // Reduces indices to at most targetIndexCount indices (or as close as it can
+    // get without folding triangles over). Returns the new index list, which
+    // references the same vertices; maxError receives the largest collapse
+    // error, as a distance in model units.
+    inline std::vector<unsigned int> simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                                              size_t targetIndexCount, float& maxError)
+    {
+        maxError = 0.0f;
+        const size_t vertexCount = vertices.size();
+
+        // Weld vertices that render identically; Assimp keeps apart corners
+        // that differ only in their tangent frame
+        struct Key
+        {
+            float values[8];
+            bool operator==(const Key& other) const { return std::memcmp(values, other.values, sizeof(values)) == 0; }
+        };
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const
+            {
+                uint32_t bits[8];
+                std::memcpy(bits, key.values, sizeof(bits));
+                size_t h = 0;
+                for (uint32_t b : bits)
+                    h = h * 0x9E3779B1u + b;
+                return h;
+            }
+        };
+        std::unordered_map<Key, unsigned int, KeyHash> welded, byPosition;
+        std::vector<unsigned int> canonical(vertexCount);
+        std::vector<uint8_t> kind(vertexCount, kManifold);
+        for (unsigned int v = 0; v < vertexCount; ++v)
+        {
+            const Vertex& vertex = vertices[v];
+            Key key = { { vertex.Position.x, vertex.Position.y, vertex.Position.z,
+                          vertex.Normal.x, vertex.Normal.y, vertex.Normal.z,
+                          vertex.TexCoords.x, vertex.TexCoords.y } };
+            canonical[v] = welded.emplace(key, v).first->second;
+            if (canonical[v] != v)
+                continue;
+
+            Key position = { { vertex.Position.x, vertex.Position.y, vertex.Position.z, 0, 0, 0, 0, 0 } };
+            auto inserted = byPosition.emplace(position, v);
+            if (!inserted.second)
+            {
+                kind[v] = kLocked;
+                kind[inserted.first->second] = kLocked;
+            }
+        }
+
+        std::vector<unsigned int> triangles;
+        triangles.reserve(indices.size());
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const unsigned int a = canonical[indices[i]], b = canonical[indices[i + 1]], c = canonical[indices[i + 2]];
+            if (a != b && b != c && a != c)
+                triangles.insert(triangles.end(), { a, b, c });
+        }
+
+        auto position = [&](unsigned int v) { return vertices[v].Position; };
+        auto edgeKey = [](unsigned int a, unsigned int b)
+        {
+            return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+        };
+
+        // Open edges are used by a single triangle
+        std::unordered_map<uint64_t, int> edgeUse;
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            for (int e = 0; e < 3; ++e)
+                ++edgeUse[edgeKey(triangles[t + e], triangles[t + (e + 1) % 3])];
+        }
+        std::unordered_set<uint64_t> borderEdges;
+
+        // Plane quadrics, area weighted, plus a perpendicular plane along every
+        // open edge so borders keep their outline
+        std::vector<Quadric> quadrics(vertexCount);
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            const glm::dvec3 p0 = position(triangles[t]), p1 = position(triangles[t + 1]), p2 = position(triangles[t + 2]);
+            const glm::dvec3 cross = glm::cross(p1 - p0, p2 - p0);
+            const double length = glm::length(cross);
+            if (length <= 0.0)
+                continue;
+            const glm::dvec3 normal = cross / length;
+            for (int e = 0; e < 3; ++e)
+                quadrics[triangles[t + e]].addPlane(normal, -glm::dot(normal, p0), 0.5 * length);
+
+            for (int e = 0; e < 3; ++e)
+            {
+                const unsigned int a = triangles[t + e], b = triangles[t + (e + 1) % 3];
+                if (edgeUse[edgeKey(a, b)] != 1)
+                    continue;
+                borderEdges.insert(edgeKey(a, b));
+                for (unsigned int v : { a, b })
+                {
+                    if (kind[v] == kManifold)
+                        kind[v] = kBorder;
+                }
+
+                const glm::dvec3 pa = position(a), pb = position(b);
+                const glm::dvec3 edge = pb - pa;
+                const double edgeLength2 = glm::dot(edge, edge);
+                if (edgeLength2 <= 0.0)
+                    continue;
+                const glm::dvec3 side = glm::normalize(glm::cross(edge, normal));
+                quadrics[a].addPlane(side, -glm::dot(side, pa), edgeLength2);
+                quadrics[b].addPlane(side, -glm::dot(side, pa), edgeLength2);
+            }
+        }
+
+        struct Collapse
+        {
+            unsigned int from;
+            unsigned int to;
+            double error;
+        };
+        std::vector<Collapse> collapses;
+        std::vector<unsigned int> adjacencyStart(vertexCount + 1), adjacency;
+        std::vector<unsigned int> remap(vertexCount);
+        std::vector<uint8_t> touched(vertexCount);
+
+        // Greedy passes: collapse the cheapest edges whose neighbourhoods do not
+        // overlap, rewrite the triangles, repeat
+        while (triangles.size() > targetIndexCount)
+        {
+            std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+            for (unsigned int v : triangles)
+                ++adjacencyStart[v + 1];
+            for (size_t v = 1; v <= vertexCount; ++v)
+                adjacencyStart[v] += adjacencyStart[v - 1];
+            adjacency.resize(triangles.size());
+            {
+                std::vector<unsigned int> cursor(adjacencyStart.begin(), adjacencyStart.end() - 1);
+                for (size_t t = 0; t < triangles.size(); t += 3)
+                {
+                    for (int e = 0; e < 3; ++e)
+                        adjacency[cursor[triangles[t + e]]++] = static_cast<unsigned int>(t);
+                }
+            }
+
+            collapses.clear();
+            for (size_t t = 0; t < triangles.size(); t += 3)
+            {
+                for (int e = 0; e < 3; ++e)
+                {
+                    const unsigned int a = triangles[t + e], b = triangles[t + (e + 1) % 3];
+                    for (int direction = 0; direction < 2; ++direction)
+                    {
+                        const unsigned int from = direction ? b : a, to = direction ? a : b;
+                        if (kind[from] == kLocked)
+                            continue;
+                        if (kind[from] == kBorder && !borderEdges.count(edgeKey(from, to)))
+                            continue;
+                        Quadric q = quadrics[from];
+                        q += quadrics[to];
+                        collapses.push_back({ from, to, q.error(position(to)) });
+                    }
+                }
+            }
+            if (collapses.empty())
+                break;
+            std::sort(collapses.begin(), collapses.end(),
+                      [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+            // Only the cheaper part of this pass's candidates, so the greedy
+            // order stays close to a global one
+            const double passLimit = collapses[collapses.size() / 3].error;
+
+            for (unsigned int v = 0; v < vertexCount; ++v)
+                remap[v] = v;
+            std::fill(touched.begin(), touched.end(), 0);
+            size_t remaining = triangles.size();
+            size_t applied = 0;
+            for (const Collapse& c : collapses)
+            {
+                if (remaining <= targetIndexCount || (c.error > passLimit && applied > 0))
+                    break;
+                if (touched[c.from] || touched[c.to])
+                    continue;
+
+                // Reject collapses that fold a triangle over
+                const glm::vec3 target = position(c.to);
+                bool folds = false;
+                size_t removed = 0;
+                for (unsigned int k = adjacencyStart[c.from]; k < adjacencyStart[c.from + 1] && !folds; ++k)
+                {
+                    const unsigned int t = adjacency[k];
+                    glm::vec3 corners[3];
+                    bool hasTo = false;
+                    for (int e = 0; e < 3; ++e)
+                    {
+                        corners[e] = position(triangles[t + e]);
+                        hasTo |= triangles[t + e] == c.to;
+                    }
+                    if (hasTo)
+                    {
+                        ++removed;
+                        continue;
+                    }
+                    const glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                    for (int e = 0; e < 3; ++e)
+                    {
+                        if (triangles[t + e] == c.from)
+                            corners[e] = target;
+                    }
+                    const glm::vec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                    folds = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+                }
+                if (folds || removed == 0)
+                    continue;
+
+                remap[c.from] = c.to;
+                quadrics[c.to] += quadrics[c.from];
+                for (unsigned int k = adjacencyStart[c.from]; k < adjacencyStart[c.from + 1]; ++k)
+                {
+                    for (int e = 0; e < 3; ++e)
+                        touched[triangles[adjacency[k] + e]] = 1;
+                }
+
+                // The border now runs through `to` instead of `from`
+                if (kind[c.from] == kBorder)
+                {
+                    for (unsigned int k = adjacencyStart[c.from]; k < adjacencyStart[c.from + 1]; ++k)
+                    {
+                        for (int e = 0; e < 3; ++e)
+                        {
+                            const unsigned int w = triangles[adjacency[k] + e];
+                            if (w != c.from && w != c.to && borderEdges.count(edgeKey(c.from, w)))
+                                borderEdges.insert(edgeKey(c.to, w));
+                        }
+                    }
+                }
+
+                maxError = std::max(maxError, static_cast<float>(std::sqrt(c.error)));
+                remaining -= 3 * removed;
+                ++applied;
+            }
+            if (applied == 0)
+                break;
+
+            size_t kept = 0;
+            for (size_t t = 0; t < triangles.size(); t += 3)
+            {
+                const unsigned int a = remap[triangles[t]], b = remap[triangles[t + 1]], c = remap[triangles[t + 2]];
+                if (a == b || b == c || a == c)
+                    continue;
+                triangles[kept++] = a;
+                triangles[kept++] = b;
+                triangles[kept++] = c;
+            }
+            triangles.resize(kept);
+        }
+        return triangles;
+    }
+}
+
+// Picks a level from how many pixels its simplification error would cover
+struct LodSelector
+{
+    float pixelsPerUnit = 0.0f;     // Screen pixels covered by one unit at distance one
+    float maxPixelError = 1.0f;
+    float hysteresis = 0.15f;       // Fraction of the switch distance to overshoot before switching
+
+    static LodSelector forProjection(float fovY, float viewportHeight, float maxPixelError = 1.0f)
+    {
+        LodSelector selector;
+        selector.pixelsPerUnit = viewportHeight / (2.0f * std::tan(0.5f * fovY));
+        selector.maxPixelError = maxPixelError;
+        return selector;
+    }
+};
+
+// Index ranges of every level of every mesh of a Model, packed into each mesh's
+// element buffer after the full-detail indices (which keep their place, so
+// Mesh::Draw still draws level 0).
+class LodChain
+{
+public:
+    static constexpr int kMaxLevels = 4;
+
+    struct Range
+    {
+        size_t firstIndex;
+        size_t indexCount;
+    };
+
+    // ratios: fraction of the original triangles each level after 0 aims for
+    LodChain(Model& model, const std::vector<float>& ratios = { 0.3f, 0.1f, 0.03f })
+    {
+        levelCount_ = std::min(kMaxLevels, static_cast<int>(ratios.size()) + 1);
+        ranges_.resize(model.meshes.size());
+        for (int level = 0; level < levelCount_; ++level)
+            errors_[level] = 0.0f;
+
+        for (size_t m = 0; m < model.meshes.size(); ++m)
+        {
+            Mesh& mesh = model.meshes[m];
+            std::vector<unsigned int> packed = mesh.indices;
+            ranges_[m][0] = { 0, mesh.indices.size() };
+            for (int level = 1; level < levelCount_; ++level)
+            {
+                const size_t target = static_cast<size_t>(mesh.indices.size() / 3 * ratios[level - 1]) * 3;
+                float error = 0.0f;
+                const std::vector<unsigned int> reduced = MeshOptimizer::optimizeVertexCache(
+                    MeshLod::simplify(mesh.vertices, mesh.indices, target, error), mesh.vertices.size());
+                ranges_[m][level] = { packed.size(), reduced.size() };
+                packed.insert(packed.end(), reduced.begin(), reduced.end());
+                errors_[level] = std::max(errors_[level], error);
+            }
+
+            // The element buffer binding is VAO state, so this replaces the mesh's own EBO
+            GlState::current().bindVertexArray(mesh.VAO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, packed.size() * sizeof(unsigned int), packed.data(), GL_STATIC_DRAW);
+        }
+
+        // Coarser levels must never switch in closer than finer ones
+        for (int level = 1; level < levelCount_; ++level)
+            errors_[level] = std::max(errors_[level], errors_[level - 1]);
+    }
+
+    int levelCount() const { return levelCount_; }
+    float error(int level) const { return errors_[level]; }
+    const Range& range(size_t mesh, int level) const { return ranges_[mesh][level]; }
+
+    size_t triangleCount(int level) const
+    {
+        size_t count = 0;
+        for (const auto& levels : ranges_)
+            count += levels[level].indexCount / 3;
+        return count;
+    }
+
+    // Coarsest level whose error stays under the selector's pixel budget at
+    // the given distance, for an instance drawn at scale
+    int levelFor(const LodSelector& selector, float distance, float scale) const
+    {
+        int level = 0;
+        while (level + 1 < levelCount_
+               && errors_[level + 1] * scale * selector.pixelsPerUnit <= selector.maxPixelError * distance)
+            ++level;
+        return level;
+    }
+
+    // levelFor with hysteresis: the level only changes once the distance is
+    // clearly past a switch point, so instances near one do not flicker
+    int select(const LodSelector& selector, float distance, float scale, int current) const
+    {
+        const int atLeast = levelFor(selector, distance * (1.0f - selector.hysteresis), scale);
+        const int atMost = levelFor(selector, distance * (1.0f + selector.hysteresis), scale);
+        return glm::clamp(current, atLeast, atMost);
+    }
+
+    void print(std::ostream& out, const char* name) const
+    {
+        out << "LOD chain for " << name << ":";
+        for (int level = 0; level < levelCount_; ++level)
+            out << " " << triangleCount(level) << " tris (error " << errors_[level] << ")";
+        out << std::endl;
+    }
+
+private:
+    int levelCount_ = 1;
+    float errors_[kMaxLevels];
+    std::vector<std::array<Range, kMaxLevels>> ranges_;
+};
+
+constexpr int LodChain::kMaxLevels;
@@ -5,6 +5,8 @@
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 
+#include "gl_state.hpp"
+#include "quantized_vertex.hpp"
 #include "shader.hpp"
 
 #include <string>
@@ -36,16 +38,47 @@ public:
 	std::vector<Texture> textures;
 	unsigned int VAO;
 	
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
+	// vertices stays in full precision for the CPU side (LOD, chunking, bounds);
+	// the GPU gets the smallest QuantizedVertex layout covering attributes
+	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+		 unsigned attributes = QuantizedVertex::kAllAttributes)
 	{
 		this->vertices = vertices;
 		this->indices = indices;
 		this->textures = textures;
+		this->layout = QuantizedVertex::choose(attributes);
 
+		nameSamplers();
 		setupMesh();
 	}
+
+	QuantizedVertex::Layout vertexLayout() const { return layout; }
+	const VertexLayout::FormatInfo& vertexFormat() const { return QuantizedVertex::info(layout); }
+	size_t vertexBufferSize() const { return vertices.size() * QuantizedVertex::stride(layout) + sizeof(QuantizedVertex::Bounds); }
 	
+	// Binds through GlState, so drawing the same mesh again only issues the draw
 	void Draw(Shader& shader)
+	{
+		GlState& gl = GlState::current();
+		for (unsigned int i = 0; i < textures.size(); i++)
+		{
+			// Samplers the shader does not use are skipped
+			if (const Shader::UniformInfo* sampler = shader.findUniform(samplerNames[i]))
+				glUniform1i(sampler->location, i);
+			gl.bindTexture(i, textures[i].id);
+		}
+
+		gl.bindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+	}
+
+private:
+	unsigned int VBO, EBO;
+	QuantizedVertex::Layout layout;
+	std::vector<std::string> samplerNames;	// texture_diffuse1, texture_specular1, ... per texture
+
+	// Sampler uniform of each texture, named once here instead of on every Draw
+	void nameSamplers()
 	{
 		unsigned int diffuseNr = 1;
 		unsigned int specularNr = 1;
@@ -54,7 +87,6 @@ public:
 
 		for (unsigned int i = 0; i < textures.size(); i++)
 		{
-			glActiveTexture(GL_TEXTURE0 + i);
 			std::string number;
 			std::string name = textures[i].type;
 			if (name == "texture_diffuse")
@@ -65,47 +97,31 @@ public:
 				number = std::to_string(normalNr++);
 			else if (name == "texture_height")
 				number = std::to_string(heightNr++);
-
-			glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+			samplerNames.push_back(name + number);
 		}
-
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-		glActiveTexture(GL_TEXTURE0);
 	}
 
-private:
-	unsigned int VBO, EBO;
-
 	void setupMesh()
 	{
 		glGenVertexArrays(1, &VAO);
 		glGenBuffers(1, &VBO);
 		glGenBuffers(1, &EBO);
 
-		glBindVertexArray(VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+		// Packed vertices, then the bounds the shaders undo the position scaling with
+		QuantizedVertex::Bounds bounds;
+		const std::vector<unsigned char> packed = QuantizedVertex::encode(vertices, layout, bounds);
+
+		GlState& gl = GlState::current();
+		gl.bindVertexArray(VAO);
+		gl.bindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, packed.size() + sizeof(bounds), nullptr, GL_STATIC_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, packed.size(), packed.data());
+		glBufferSubData(GL_ARRAY_BUFFER, packed.size(), sizeof(bounds), &bounds);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-		glEnableVertexAttribArray(5);
-		glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-
-		glBindVertexArray(0);
+		QuantizedVertex::setupAttributes(layout, static_cast<GLintptr>(packed.size()));
+
+		gl.bindVertexArray(0);
 	}
 };
\ No newline at end of file
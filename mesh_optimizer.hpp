@@ -0,0 +1,557 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Load-time reordering of a mesh's triangles and vertices for the GPU:
+//
+//   1. Vertex cache: triangles are reordered so the vertices they share are
+//      still in the post-transform cache (Forsyth's greedy scoring).
+//   2. Overdraw: the cache-friendly order is cut into clusters where that costs
+//      little cache efficiency, and the clusters are sorted so the ones facing
+//      outward are drawn first and hide what is behind them (Tipsify-style).
+//   3. Vertex fetch: vertices are renumbered in the order the triangles first
+//      use them, so the vertex shader reads the vertex buffer front to back.
+//
+// Quality is reported as ACMR, the average cache miss ratio: vertices
+// transformed per triangle with a simulated FIFO cache. 3.0 means nothing is
+// shared, about 0.5 is the best a regular grid can reach.
+//
+// Results are kept in a DiskCache next to the model file, so only the first
+// run after the mesh changes pays for the optimization.
+namespace MeshOptimizer
+{
+    // FIFO size simulated for ACMR (and for the overdraw clustering)
+    constexpr unsigned kFifoCacheSize = 16;
+
+    // LRU size the vertex cache ordering scores for
+    constexpr unsigned kScoreCacheSize = 32;
+
+    // Counts the vertices of one triangle missing from a simulated FIFO cache;
+    // a vertex is cached while fewer than cacheSize misses followed its own.
+    // Advancing time by cacheSize + 1 flushes the cache.
+    inline unsigned fifoMisses(const unsigned int* triangle, std::vector<unsigned>& stamps, unsigned& time,
+                               unsigned cacheSize = kFifoCacheSize)
+    {
+        unsigned misses = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            unsigned& stamp = stamps[triangle[corner]];
+            if (time - stamp > cacheSize)
+            {
+                stamp = time++;
+                ++misses;
+            }
+        }
+        return misses;
+    }
+
+    inline float acmr(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned cacheSize = kFifoCacheSize)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return 0.0f;
+        std::vector<unsigned> stamps(vertexCount, 0);
+        unsigned time = cacheSize + 1;
+        size_t misses = 0;
+        for (size_t t = 0; t < triangleCount; ++t)
+            misses += fifoMisses(&indices[3 * t], stamps, time, cacheSize);
+        return static_cast<float>(misses) / static_cast<float>(triangleCount);
+    }
+
+    // Forsyth's vertex score: high for vertices near the front of the cache,
+    // and for vertices with few triangles left, so no vertex is left stranded
+    inline float vertexScore(int cachePosition, unsigned remaining)
+    {
+        if (remaining == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            // The last triangle's vertices score the same whatever their order
+            if (cachePosition < 3)
+                score = 0.75f;
+            else
+                score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / (kScoreCacheSize - 3), 1.5f);
+        }
+        return score + 2.0f / std::sqrt(static_cast<float>(remaining));
+    }
+
+    // Same triangles in an order that reuses the post-transform cache.
+    // Greedy: always emits the best scoring triangle that uses a cached
+    // vertex, falling back to the next unemitted one in the input order.
+    inline std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        std::vector<unsigned int> result;
+        result.reserve(triangleCount * 3);
+        if (triangleCount == 0)
+            return result;
+
+        // Triangles of every vertex; the ones not yet emitted are kept at the
+        // front of each list, remaining[v] long
+        std::vector<unsigned> start(vertexCount + 1, 0);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+            ++start[indices[i] + 1];
+        for (size_t v = 1; v <= vertexCount; ++v)
+            start[v] += start[v - 1];
+        std::vector<unsigned> adjacency(triangleCount * 3);
+        {
+            std::vector<unsigned> cursor(start.begin(), start.end() - 1);
+            for (size_t i = 0; i < triangleCount * 3; ++i)
+                adjacency[cursor[indices[i]]++] = static_cast<unsigned>(i / 3);
+        }
+        std::vector<unsigned> remaining(vertexCount);
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> scores(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            remaining[v] = start[v + 1] - start[v];
+            scores[v] = vertexScore(-1, remaining[v]);
+        }
+
+        // Start from the best triangle overall
+        auto triangleScore = [&](size_t t)
+        {
+            return scores[indices[3 * t]] + scores[indices[3 * t + 1]] + scores[indices[3 * t + 2]];
+        };
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        size_t best = 0;
+        float bestScore = triangleScore(0);
+        for (size_t t = 1; t < triangleCount; ++t)
+        {
+            const float score = triangleScore(t);
+            if (score > bestScore)
+            {
+                bestScore = score;
+                best = t;
+            }
+        }
+
+        unsigned cache[kScoreCacheSize + 3];
+        size_t cacheCount = 0;
+        size_t scan = 0;
+        bool found = true;
+        while (result.size() < triangleCount * 3)
+        {
+            if (!found)
+            {
+                while (emitted[scan])
+                    ++scan;
+                best = scan;
+            }
+
+            const unsigned int* triangle = &indices[3 * best];
+            result.insert(result.end(), triangle, triangle + 3);
+            emitted[best] = 1;
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                const unsigned v = triangle[corner];
+                unsigned* list = &adjacency[start[v]];
+                for (unsigned k = 0; k < remaining[v]; ++k)
+                {
+                    if (list[k] == best)
+                    {
+                        std::swap(list[k], list[remaining[v] - 1]);
+                        break;
+                    }
+                }
+                --remaining[v];
+            }
+
+            // The triangle's vertices move to the front of the LRU cache
+            unsigned next[kScoreCacheSize + 3];
+            size_t nextCount = 0;
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                if (std::find(next, next + nextCount, triangle[corner]) == next + nextCount)
+                    next[nextCount++] = triangle[corner];
+            }
+            for (size_t k = 0; k < cacheCount; ++k)
+            {
+                if (std::find(triangle, triangle + 3, cache[k]) == triangle + 3)
+                    next[nextCount++] = cache[k];
+            }
+            for (size_t k = 0; k < nextCount; ++k)
+                cachePosition[next[k]] = k < kScoreCacheSize ? static_cast<int>(k) : -1;
+
+            // Rescore the cached and the evicted vertices; the next triangle is
+            // the best one using a cached vertex
+            for (size_t k = 0; k < nextCount; ++k)
+                scores[next[k]] = vertexScore(cachePosition[next[k]], remaining[next[k]]);
+            found = false;
+            bestScore = 0.0f;
+            for (size_t k = 0; k < std::min<size_t>(nextCount, kScoreCacheSize); ++k)
+            {
+                const unsigned v = next[k];
+                for (unsigned j = 0; j < remaining[v]; ++j)
+                {
+                    const unsigned t = adjacency[start[v] + j];
+                    const float score = triangleScore(t);
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        best = t;
+                        found = true;
+                    }
+                }
+            }
+
+            cacheCount = std::min<size_t>(nextCount, kScoreCacheSize);
+            std::copy(next, next + cacheCount, cache);
+        }
+        return result;
+    }
+
+    // Reorders the triangles of a cache-optimized index list in clusters to
+    // reduce overdraw. A cluster ends where its ACMR has come within threshold
+    // of the ACMR of the patch it belongs to, so cache efficiency drops by at
+    // most about that factor. Clusters facing away from the mesh centre, i.e.
+    // outward, are drawn first.
+    inline void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions,
+                                 float threshold = 1.05f)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount < 2)
+            return;
+
+        std::vector<unsigned> stamps(positions.size(), 0);
+        unsigned time = kFifoCacheSize + 1;
+
+        // Patches: a triangle with three misses starts an unconnected part
+        std::vector<size_t> patches;
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            if (fifoMisses(&indices[3 * t], stamps, time) == 3 || t == 0)
+                patches.push_back(t);
+        }
+        patches.push_back(triangleCount);
+
+        std::vector<size_t> clusters;
+        for (size_t p = 0; p + 1 < patches.size(); ++p)
+        {
+            const size_t begin = patches[p], end = patches[p + 1];
+            time += kFifoCacheSize + 1;
+            size_t patchMisses = 0;
+            for (size_t t = begin; t < end; ++t)
+                patchMisses += fifoMisses(&indices[3 * t], stamps, time);
+            const float target = threshold * static_cast<float>(patchMisses) / static_cast<float>(end - begin);
+
+            // Flushing the cache at every cut is what the clusters pay in ACMR
+            clusters.push_back(begin);
+            time += kFifoCacheSize + 1;
+            size_t misses = 0, faces = 0;
+            for (size_t t = begin; t < end; ++t)
+            {
+                misses += fifoMisses(&indices[3 * t], stamps, time);
+                ++faces;
+                if (static_cast<float>(misses) <= target * static_cast<float>(faces) && t + 1 < end)
+                {
+                    clusters.push_back(t + 1);
+                    time += kFifoCacheSize + 1;
+                    misses = faces = 0;
+                }
+            }
+        }
+        clusters.push_back(triangleCount);
+
+        // Area-weighted centroid and normal of every cluster
+        glm::dvec3 meshCentroid(0.0);
+        double meshArea = 0.0;
+        struct Cluster
+        {
+            size_t begin;
+            size_t end;
+            glm::dvec3 centroid;
+            glm::dvec3 normal;
+            double sortKey;
+        };
+        std::vector<Cluster> sorted;
+        sorted.reserve(clusters.size() - 1);
+        for (size_t c = 0; c + 1 < clusters.size(); ++c)
+        {
+            Cluster cluster = { clusters[c], clusters[c + 1], glm::dvec3(0.0), glm::dvec3(0.0), 0.0 };
+            double area = 0.0;
+            for (size_t t = cluster.begin; t < cluster.end; ++t)
+            {
+                const glm::dvec3 p0 = positions[indices[3 * t]], p1 = positions[indices[3 * t + 1]], p2 = positions[indices[3 * t + 2]];
+                const glm::dvec3 cross = glm::cross(p1 - p0, p2 - p0);
+                const double triangleArea = glm::length(cross);
+                cluster.centroid += (p0 + p1 + p2) * (triangleArea / 3.0);
+                cluster.normal += cross;
+                area += triangleArea;
+            }
+            meshCentroid += cluster.centroid;
+            meshArea += area;
+            cluster.centroid = area > 0.0 ? cluster.centroid / area : glm::dvec3(positions[indices[3 * cluster.begin]]);
+            sorted.push_back(cluster);
+        }
+        if (meshArea > 0.0)
+            meshCentroid /= meshArea;
+
+        for (Cluster& cluster : sorted)
+        {
+            const double length = glm::length(cluster.normal);
+            cluster.sortKey = length > 0.0 ? glm::dot(cluster.centroid - meshCentroid, cluster.normal / length) : 0.0;
+        }
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        for (const Cluster& cluster : sorted)
+            result.insert(result.end(), indices.begin() + 3 * cluster.begin, indices.begin() + 3 * cluster.end);
+        indices.swap(result);
+    }
+
+    // Renumbers the vertices in order of first use and rewrites indices to
+    // match. Returns the old index of every new vertex; vertices no triangle
+    // uses keep a place at the end.
+    inline std::vector<unsigned int> optimizeVertexFetch(std::vector<unsigned int>& indices, size_t vertexCount)
+    {
+        const unsigned int kUnused = UINT32_MAX;
+        std::vector<unsigned int> newIndex(vertexCount, kUnused);
+        std::vector<unsigned int> order;
+        order.reserve(vertexCount);
+        for (unsigned int& index : indices)
+        {
+            if (newIndex[index] == kUnused)
+            {
+                newIndex[index] = static_cast<unsigned int>(order.size());
+                order.push_back(index);
+            }
+            index = newIndex[index];
+        }
+        for (unsigned int v = 0; v < vertexCount; ++v)
+        {
+            if (newIndex[v] == kUnused)
+                order.push_back(v);
+        }
+        return order;
+    }
+
+    // Optimized index lists and vertex orders of the meshes of one model file,
+    // keyed by a hash of each mesh's positions and indices. Entries are only
+    // ever looked up by the mesh they were made from, so an edited model just
+    // misses; save() drops the entries no mesh asked for.
+    class DiskCache
+    {
+    public:
+        explicit DiskCache(const std::string& path) : path_(path)
+        {
+            load();
+        }
+
+        DiskCache(const DiskCache&) = delete;
+        DiskCache& operator=(const DiskCache&) = delete;
+
+        // FNV-1a over the counts, the positions and the indices
+        static uint64_t key(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+        {
+            uint64_t hash = 14695981039346656037ull;
+            auto mix = [&hash](const void* data, size_t size)
+            {
+                const unsigned char* bytes = static_cast<const unsigned char*>(data);
+                for (size_t i = 0; i < size; ++i)
+                    hash = (hash ^ bytes[i]) * 1099511628211ull;
+            };
+            const uint64_t counts[2] = { positions.size(), indices.size() };
+            mix(counts, sizeof(counts));
+            mix(positions.data(), positions.size() * sizeof(glm::vec3));
+            mix(indices.data(), indices.size() * sizeof(unsigned int));
+            return hash;
+        }
+
+        // On a hit, replaces indices with the optimized ones and fills order
+        bool find(uint64_t key, size_t vertexCount, std::vector<unsigned int>& indices, std::vector<unsigned int>& order)
+        {
+            const auto it = entries_.find(key);
+            if (it == entries_.end())
+                return false;
+            Entry& entry = it->second;
+            if (entry.order.size() != vertexCount || entry.indices.size() != indices.size() || !valid(entry, vertexCount))
+                return false;
+            entry.used = true;
+            indices = entry.indices;
+            order = entry.order;
+            return true;
+        }
+
+        void insert(uint64_t key, const std::vector<unsigned int>& order, const std::vector<unsigned int>& indices)
+        {
+            Entry& entry = entries_[key];
+            entry.order = order;
+            entry.indices = indices;
+            entry.used = true;
+            dirty_ = true;
+        }
+
+        // Rewrites the file if an entry was added or went unused
+        void save()
+        {
+            size_t used = 0;
+            for (const auto& entry : entries_)
+                used += entry.second.used ? 1 : 0;
+            if (!dirty_ && used == entries_.size())
+                return;
+
+            std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+            const uint32_t header[3] = { kMagic, kVersion, static_cast<uint32_t>(used) };
+            out.write(reinterpret_cast<const char*>(header), sizeof(header));
+            for (const auto& it : entries_)
+            {
+                const Entry& entry = it.second;
+                if (!entry.used)
+                    continue;
+                const uint64_t key = it.first;
+                const uint32_t counts[2] = { static_cast<uint32_t>(entry.order.size()), static_cast<uint32_t>(entry.indices.size()) };
+                out.write(reinterpret_cast<const char*>(&key), sizeof(key));
+                out.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+                out.write(reinterpret_cast<const char*>(entry.order.data()), entry.order.size() * sizeof(unsigned int));
+                out.write(reinterpret_cast<const char*>(entry.indices.data()), entry.indices.size() * sizeof(unsigned int));
+            }
+            if (!out)
+                std::cerr << "WARNING::MESH_OPTIMIZER:: could not write " << path_ << std::endl;
+            dirty_ = false;
+        }
+
+    private:
+        static constexpr uint32_t kMagic = 0x54504F4Du;     // "MOPT"
+        static constexpr uint32_t kVersion = 1;             // Bump when the optimizer's output changes
+
+        struct Entry
+        {
+            std::vector<unsigned int> order;
+            std::vector<unsigned int> indices;
+            bool used = false;
+        };
+
+        // A damaged file must not produce out-of-range indices
+        static bool valid(const Entry& entry, size_t vertexCount)
+        {
+            std::vector<uint8_t> seen(vertexCount, 0);
+            for (unsigned int v : entry.order)
+            {
+                if (v >= vertexCount || seen[v])
+                    return false;
+                seen[v] = 1;
+            }
+            for (unsigned int index : entry.indices)
+            {
+                if (index >= vertexCount)
+                    return false;
+            }
+            return true;
+        }
+
+        // A missing, foreign, truncated or damaged file is an empty cache
+        void load()
+        {
+            std::ifstream in(path_, std::ios::binary | std::ios::ate);
+            if (!in)
+                return;
+            // Entry sizes are checked against what is left of the file before
+            // anything is allocated for them
+            uint64_t remaining = static_cast<uint64_t>(in.tellg());
+            in.seekg(0);
+            uint32_t header[3];
+            if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != kMagic || header[1] != kVersion)
+                return;
+            remaining -= sizeof(header);
+            for (uint32_t e = 0; e < header[2]; ++e)
+            {
+                uint64_t key;
+                uint32_t counts[2];
+                if (!in.read(reinterpret_cast<char*>(&key), sizeof(key)) || !in.read(reinterpret_cast<char*>(counts), sizeof(counts)))
+                {
+                    entries_.clear();
+                    return;
+                }
+                remaining -= sizeof(key) + sizeof(counts);
+                const uint64_t bytes = (static_cast<uint64_t>(counts[0]) + counts[1]) * sizeof(unsigned int);
+                if (bytes > remaining)
+                {
+                    entries_.clear();
+                    return;
+                }
+                remaining -= bytes;
+                Entry entry;
+                entry.order.resize(counts[0]);
+                entry.indices.resize(counts[1]);
+                if (!in.read(reinterpret_cast<char*>(entry.order.data()), entry.order.size() * sizeof(unsigned int))
+                    || !in.read(reinterpret_cast<char*>(entry.indices.data()), entry.indices.size() * sizeof(unsigned int)))
+                {
+                    entries_.clear();
+                    return;
+                }
+                entries_.emplace(key, std::move(entry));
+            }
+        }
+
+        std::string path_;
+        std::unordered_map<uint64_t, Entry> entries_;
+        bool dirty_ = false;
+    };
+
+    struct Report
+    {
+        size_t triangles = 0;
+        float acmrBefore = 0.0f;
+        float acmrAfter = 0.0f;
+        bool cached = false;
+    };
+
+    inline void print(std::ostream& out, const std::string& name, size_t mesh, const Report& report)
+    {
+        out << "Mesh optimizer: " << name << " mesh " << mesh << ", " << report.triangles << " triangles, ACMR "
+            << std::fixed << std::setprecision(3) << report.acmrBefore << " -> " << report.acmrAfter
+            << std::defaultfloat << (report.cached ? " (cached)" : "") << std::endl;
+    }
+
+    // Runs all three passes on one mesh, or takes their result from cache,
+    // and reorders vertices to match. positionOf(vertex) returns a glm::vec3.
+    template <typename VertexType, typename PositionOf>
+    Report optimize(std::vector<VertexType>& vertices, std::vector<unsigned int>& indices, PositionOf positionOf,
+                    DiskCache& cache)
+    {
+        Report report;
+        report.triangles = indices.size() / 3;
+        report.acmrBefore = acmr(indices, vertices.size());
+
+        std::vector<glm::vec3> positions(vertices.size());
+        for (size_t v = 0; v < vertices.size(); ++v)
+            positions[v] = positionOf(vertices[v]);
+
+        const uint64_t key = DiskCache::key(positions, indices);
+        std::vector<unsigned int> order;
+        report.cached = cache.find(key, vertices.size(), indices, order);
+        if (!report.cached)
+        {
+            indices = optimizeVertexCache(indices, vertices.size());
+            optimizeOverdraw(indices, positions);
+            order = optimizeVertexFetch(indices, vertices.size());
+            cache.insert(key, order, indices);
+        }
+
+        std::vector<VertexType> reordered;
+        reordered.reserve(vertices.size());
+        for (unsigned int old : order)
+            reordered.push_back(vertices[old]);
+        vertices.swap(reordered);
+
+        report.acmrAfter = acmr(indices, vertices.size());
+        return report;
+    }
+}
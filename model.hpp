@@ -11,8 +11,10 @@
 #include <assimp/postprocess.h>
 
 #include "mesh.hpp"
+#include "mesh_optimizer.hpp"
 #include "shader.hpp"
 
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -42,11 +44,24 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // Radius of the sphere around the model origin that holds every vertex
+    float boundingRadius() const
+    {
+        float radius = 0.0f;
+        for (const Mesh& mesh : meshes)
+        {
+            for (const Vertex& vertex : mesh.vertices)
+                radius = std::max(radius, glm::length(vertex.Position));
+        }
+        return radius;
+    }
+
 private:
     void loadModel(string const& path)
     {
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        // Identical corners are joined, so triangles share vertices and the post-transform cache has something to reuse
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
 
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
@@ -55,25 +70,27 @@ private:
         }
         directory = path.substr(0, path.find_last_of('/'));
 
-        processNode(scene->mRootNode, scene);
+        MeshOptimizer::DiskCache optimizerCache(path + ".meshopt");
+        processNode(scene->mRootNode, scene, path, optimizerCache);
+        optimizerCache.save();
         std::cout << "Model Loaded Successfully!" << std::endl;
     }
 
-    void processNode(aiNode* node, const aiScene* scene)
+    void processNode(aiNode* node, const aiScene* scene, const string& path, MeshOptimizer::DiskCache& optimizerCache)
     {
         for (unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            meshes.push_back(processMesh(mesh, scene, path, optimizerCache));
         }
 
         for (unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, path, optimizerCache);
         }
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+    Mesh processMesh(aiMesh* mesh, const aiScene* scene, const string& path, MeshOptimizer::DiskCache& optimizerCache)
     {
         vector<Vertex> vertices;
         vector<unsigned int> indices;
@@ -127,6 +144,11 @@ private:
                 indices.push_back(face.mIndices[j]);
         }
 
+        // Vertex cache, overdraw and vertex fetch order, before anything reads the indices
+        const MeshOptimizer::Report report = MeshOptimizer::optimize(vertices, indices,
+            [](const Vertex& vertex) { return vertex.Position; }, optimizerCache);
+        MeshOptimizer::print(std::cout, path, meshes.size(), report);
+
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
 
@@ -139,7 +161,20 @@ private:
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-        return Mesh(vertices, indices, textures);
+        // Only what the mesh has goes to the GPU; tangents only serve a normal map
+        unsigned attributes = 0;
+        if (mesh->HasNormals())
+            attributes |= QuantizedVertex::kNormal;
+        if (mesh->mTextureCoords[0])
+            attributes |= QuantizedVertex::kTexCoords;
+        if (mesh->mTextureCoords[0] && !normalMaps.empty())
+            attributes |= QuantizedVertex::kTangent;
+
+        Mesh result(vertices, indices, textures, attributes);
+        std::cout << "Vertex format: " << path << " mesh " << meshes.size() << ", " << QuantizedVertex::name(result.vertexLayout())
+                  << ", " << result.vertexBufferSize() / 1024 << " KiB instead of " << vertices.size() * sizeof(Vertex) / 1024
+                  << " KiB (" << QuantizedVertex::stride(result.vertexLayout()) << " bytes per vertex instead of " << sizeof(Vertex) << ")" << std::endl;
+        return result;
     }
 
     vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
@@ -194,7 +229,7 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
         else if (nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GlState::current().bindTexture(0, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm.hpp>
+#include <gtc/packing.hpp>
+
+#include "vertex_layout.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Compact GPU vertex layouts for static meshes. The layouts form a family of
+// prefixes of one packed record, so a mesh's vertex buffer only holds the
+// attributes it actually has:
+//
+//   offset  attribute                                   layout ending here
+//        0  position, 3 x snorm16 within the mesh bounds  kPosition                   8 bytes
+//        8  normal, GL_INT_2_10_10_10_REV                 kPositionNormal            12 bytes
+//       12  texture coordinates, 2 x half float           kPositionNormalUv          16 bytes
+//       16  tangent, 2_10_10_10, bitangent sign in w      kPositionNormalUvTangent   20 bytes
+//
+// against 88 bytes for a float Vertex. Positions are stored relative to the
+// mesh's bounding cube; the shaders read it from kPositionBoundsAttribute
+// (centre, half extent) and undo the scaling. That attribute comes from the
+// mesh's VAO with a divisor no draw reaches, so every draw of the mesh, plain
+// or instanced, sees the same per-mesh value. Float positions use the
+// identity bounds (0, 0, 0, 1), see setupBounds().
+namespace QuantizedVertex
+{
+    static constexpr GLuint kPositionBoundsAttribute = 9;
+
+    using VertexLayout::Attribute;
+    using VertexLayout::kNormalized;
+
+    using PositionFormat = VertexLayout::Format<
+        Attribute<0, int16_t, 3, kNormalized>, VertexLayout::Padding<2>>;
+    using PositionNormalFormat = VertexLayout::Format<
+        Attribute<0, int16_t, 3, kNormalized>, VertexLayout::Padding<2>,
+        Attribute<1, VertexLayout::Int2101010, 4, kNormalized>>;
+    using PositionNormalUvFormat = VertexLayout::Format<
+        Attribute<0, int16_t, 3, kNormalized>, VertexLayout::Padding<2>,
+        Attribute<1, VertexLayout::Int2101010, 4, kNormalized>,
+        Attribute<2, VertexLayout::Half, 2>>;
+    using PositionNormalUvTangentFormat = VertexLayout::Format<
+        Attribute<0, int16_t, 3, kNormalized>, VertexLayout::Padding<2>,
+        Attribute<1, VertexLayout::Int2101010, 4, kNormalized>,
+        Attribute<2, VertexLayout::Half, 2>,
+        Attribute<3, VertexLayout::Int2101010, 4, kNormalized>>;
+
+    // Centre and half extent, one vec4 per mesh
+    using BoundsFormat = VertexLayout::Format<Attribute<kPositionBoundsAttribute, float, 4>>;
+
+    enum Attributes : unsigned
+    {
+        kNormal = 1 << 0,
+        kTexCoords = 1 << 1,
+        kTangent = 1 << 2,
+        kAllAttributes = kNormal | kTexCoords | kTangent
+    };
+
+    enum Layout
+    {
+        kPosition,
+        kPositionNormal,
+        kPositionNormalUv,
+        kPositionNormalUvTangent
+    };
+
+    struct Packed
+    {
+        int16_t position[4];        // w unused, keeps the normal 4-byte aligned
+        uint32_t normal;
+        uint16_t texCoords[2];
+        uint32_t tangent;
+    };
+    static_assert(PositionNormalUvTangentFormat::stride == sizeof(Packed), "Packed must have no padding, the layouts are prefixes of it");
+    static_assert(PositionNormalUvTangentFormat::offsetOf(1) == offsetof(Packed, normal)
+                  && PositionNormalUvTangentFormat::offsetOf(2) == offsetof(Packed, texCoords)
+                  && PositionNormalUvTangentFormat::offsetOf(3) == offsetof(Packed, tangent),
+                  "The formats must match Packed");
+    static_assert(PositionFormat::stride == offsetof(Packed, normal) && PositionNormalFormat::stride == offsetof(Packed, texCoords)
+                  && PositionNormalUvFormat::stride == offsetof(Packed, tangent),
+                  "Each layout must end where the next attribute starts");
+
+    inline const VertexLayout::FormatInfo& info(Layout layout)
+    {
+        switch (layout)
+        {
+        case kPosition: return PositionFormat::info();
+        case kPositionNormal: return PositionNormalFormat::info();
+        case kPositionNormalUv: return PositionNormalUvFormat::info();
+        default: return PositionNormalUvTangentFormat::info();
+        }
+    }
+
+    inline GLsizei stride(Layout layout)
+    {
+        return info(layout).stride;
+    }
+
+    inline const char* name(Layout layout)
+    {
+        static const char* const names[] = { "position", "position+normal", "position+normal+uv", "position+normal+uv+tangent" };
+        return names[layout];
+    }
+
+    // Smallest layout that covers attributes; a later attribute needs the
+    // ones before it, so a tangent without texture coordinates still gets them
+    inline Layout choose(unsigned attributes)
+    {
+        if (attributes & kTangent)
+            return kPositionNormalUvTangent;
+        if (attributes & kTexCoords)
+            return kPositionNormalUv;
+        if (attributes & kNormal)
+            return kPositionNormal;
+        return kPosition;
+    }
+
+    // Stored after the vertices and read as one vec4
+    struct Bounds
+    {
+        glm::vec3 center = glm::vec3(0.0f);
+        float halfExtent = 1.0f;    // Of the cube, so one scale serves all three axes
+    };
+    static_assert(sizeof(Bounds) == 4 * sizeof(float), "Bounds is read as a vec4");
+
+    inline int16_t snorm16(float value)
+    {
+        return static_cast<int16_t>(std::lround(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    inline uint32_t snorm10(float value)
+    {
+        return static_cast<uint32_t>(std::lround(glm::clamp(value, -1.0f, 1.0f) * 511.0f)) & 0x3FFu;
+    }
+
+    // GL_INT_2_10_10_10_REV: x in the low bits, w a 2-bit signed -1..1
+    inline uint32_t pack1010102(const glm::vec3& v, float w = 0.0f)
+    {
+        const uint32_t packedW = static_cast<uint32_t>(std::lround(glm::clamp(w, -1.0f, 1.0f))) & 0x3u;
+        return snorm10(v.x) | snorm10(v.y) << 10 | snorm10(v.z) << 20 | packedW << 30;
+    }
+
+    // Encodes vertices, any struct with Position, Normal, TexCoords, Tangent
+    // and Bitangent, in layout. Returns the bytes for the vertex buffer.
+    template <typename VertexType>
+    std::vector<unsigned char> encode(const std::vector<VertexType>& vertices, Layout layout, Bounds& bounds)
+    {
+        glm::vec3 lower(0.0f), upper(0.0f);
+        if (!vertices.empty())
+        {
+            lower = upper = vertices[0].Position;
+            for (const VertexType& vertex : vertices)
+            {
+                lower = glm::min(lower, vertex.Position);
+                upper = glm::max(upper, vertex.Position);
+            }
+        }
+        const glm::vec3 halfSize = 0.5f * (upper - lower);
+        bounds.center = 0.5f * (lower + upper);
+        bounds.halfExtent = std::max(std::max(halfSize.x, halfSize.y), std::max(halfSize.z, 1e-6f));
+
+        const size_t size = static_cast<size_t>(stride(layout));
+        std::vector<unsigned char> bytes(vertices.size() * size);
+        for (size_t v = 0; v < vertices.size(); ++v)
+        {
+            const VertexType& vertex = vertices[v];
+            Packed packed;
+            std::memset(&packed, 0, sizeof(packed));
+            const glm::vec3 local = (vertex.Position - bounds.center) / bounds.halfExtent;
+            packed.position[0] = snorm16(local.x);
+            packed.position[1] = snorm16(local.y);
+            packed.position[2] = snorm16(local.z);
+            if (layout >= kPositionNormal)
+                packed.normal = pack1010102(vertex.Normal);
+            if (layout >= kPositionNormalUv)
+            {
+                packed.texCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+                packed.texCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+            }
+            if (layout >= kPositionNormalUvTangent)
+            {
+                const float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+                packed.tangent = pack1010102(vertex.Tangent, handedness);
+            }
+            std::memcpy(&bytes[v * size], &packed, size);
+        }
+        return bytes;
+    }
+
+    // Points the bound VAO's kPositionBoundsAttribute at the Bounds stored at
+    // boundsOffset in the bound GL_ARRAY_BUFFER
+    inline void setupBounds(GLintptr boundsOffset)
+    {
+        BoundsFormat::setup(boundsOffset, UINT32_MAX);
+    }
+
+    // Points the bound VAO at vertices in layout at the start of the bound
+    // GL_ARRAY_BUFFER, and at the Bounds stored at boundsOffset in it
+    inline void setupAttributes(Layout layout, GLintptr boundsOffset)
+    {
+        switch (layout)
+        {
+        case kPosition: PositionFormat::setup(); break;
+        case kPositionNormal: PositionNormalFormat::setup(); break;
+        case kPositionNormalUv: PositionNormalUvFormat::setup(); break;
+        default: PositionNormalUvTangentFormat::setup(); break;
+        }
+        setupBounds(boundsOffset);
+    }
+}
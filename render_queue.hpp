@@ -0,0 +1,189 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "gl_state.hpp"
+#include "streaming_buffer.hpp"
+#include "uniform_blocks.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Draws collected over a frame, sorted by a packed 64-bit key and then
+// executed in that order, so draws that share state run back to back and
+// each group is drawn front to back for early depth rejection.
+//
+// Key layout, most significant first:
+//
+//   63-60  pass        kOpaque before kCutout (alpha-tested impostors)
+//   59-52  program     low bits of the GL names; a collision only costs
+//   51-40  material    batching, since GlState still compares the real
+//   39-28  mesh        names before binding
+//   27-12  depth       distance from the eye, 16-bit, nearest first
+//   11-0   unused
+//
+// Per-draw ObjectConstants are gathered with addObject() and uploaded with
+// a single mapping when the queue executes; draws that share constants share
+// the index, and rebinding the same range is elided by GlState.
+//
+//   queue.clear();
+//   const uint32_t object = queue.addObject(constants);
+//   queue.submit(RenderQueue::kOpaque, item, distance);    // item.object = object
+//   queue.execute(streaming);                                // with FrameConstants bound
+class RenderQueue
+{
+public:
+    enum Pass { kOpaque = 0, kCutout = 1 };
+
+    static constexpr uint32_t kNoObject = UINT32_MAX;
+
+    struct DrawItem
+    {
+        GLuint program = 0;
+        GLuint textures[2] = {};        // On units 0 and 1; 0 leaves the unit alone
+        GLuint vao = 0;
+        GLenum mode = GL_TRIANGLES;
+        bool indexed = true;            // Indices from the VAO's element buffer
+        GLenum indexType = GL_UNSIGNED_INT;     // Or GL_UNSIGNED_SHORT
+        GLsizei count = 0;              // Indices or vertices
+        size_t first = 0;               // First index or vertex
+        GLsizei instances = 0;          // 0 for a non-instanced draw
+        uint32_t object = kNoObject;    // From addObject()
+
+        // Called with context and argument after the state is bound and
+        // before the draw, e.g. to point instance attributes at this draw's range
+        void (*prepare)(const void* context, uint32_t argument) = nullptr;
+        const void* context = nullptr;
+        uint32_t argument = 0;
+    };
+
+    // Distances at or beyond maxDepth share the last depth bucket
+    float maxDepth = 100.0f;
+
+    void clear()
+    {
+        items_.clear();
+        entries_.clear();
+        objects_.clear();
+    }
+
+    uint32_t addObject(const UniformBlocks::ObjectConstants& constants)
+    {
+        objects_.push_back(constants);
+        return static_cast<uint32_t>(objects_.size() - 1);
+    }
+
+    void submit(Pass pass, const DrawItem& item, float depth)
+    {
+        entries_.push_back({ makeKey(pass, item, depth), static_cast<uint32_t>(items_.size()) });
+        items_.push_back(item);
+    }
+
+    size_t size() const { return items_.size(); }
+
+    // Sorts by key and issues every draw; the queue keeps its contents until clear()
+    void execute(StreamingBuffer& streaming)
+    {
+        if (entries_.empty())
+            return;
+        radixSort(entries_, scratch_);
+
+        UniformBlocks::ObjectConstantsArray objects(streaming, objects_.size());
+        for (size_t i = 0; i < objects_.size(); ++i)
+            objects.set(i, objects_[i]);
+
+        GlState& gl = GlState::current();
+        for (const Entry& entry : entries_)
+        {
+            const DrawItem& item = items_[entry.item];
+            gl.useProgram(item.program);
+            for (unsigned unit = 0; unit < 2; ++unit)
+            {
+                if (item.textures[unit])
+                    gl.bindTexture(unit, item.textures[unit]);
+            }
+            gl.bindVertexArray(item.vao);
+            if (item.object != kNoObject)
+                objects.bind(item.object);
+            if (item.prepare)
+                item.prepare(item.context, item.argument);
+
+            if (item.indexed)
+            {
+                const size_t indexSize = item.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+                const void* offset = (void*)(item.first * indexSize);
+                if (item.instances > 0)
+                    glDrawElementsInstanced(item.mode, item.count, item.indexType, offset, item.instances);
+                else
+                    glDrawElements(item.mode, item.count, item.indexType, offset);
+            }
+            else
+            {
+                const GLint first = static_cast<GLint>(item.first);
+                if (item.instances > 0)
+                    glDrawArraysInstanced(item.mode, first, item.count, item.instances);
+                else
+                    glDrawArrays(item.mode, first, item.count);
+            }
+        }
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        uint32_t item;
+    };
+
+    uint64_t makeKey(Pass pass, const DrawItem& item, float depth) const
+    {
+        const float normalized = std::min(std::max(depth / maxDepth, 0.0f), 1.0f);
+        const uint64_t depthBits = static_cast<uint64_t>(normalized * 65535.0f);
+        return (static_cast<uint64_t>(pass) & 0xF) << 60
+             | (static_cast<uint64_t>(item.program) & 0xFF) << 52
+             | (static_cast<uint64_t>(item.textures[0]) & 0xFFF) << 40
+             | (static_cast<uint64_t>(item.vao) & 0xFFF) << 28
+             | depthBits << 12;
+    }
+
+    // LSD radix sort on 8-bit digits; stable, so equal keys keep submission
+    // order. All eight histograms come from one sweep, and a digit on which
+    // every key agrees (the unused low bits, usually the pass) costs nothing.
+    static void radixSort(std::vector<Entry>& entries, std::vector<Entry>& scratch)
+    {
+        const size_t count = entries.size();
+        size_t histograms[8][256] = {};
+        for (const Entry& entry : entries)
+        {
+            for (int digit = 0; digit < 8; ++digit)
+                ++histograms[digit][(entry.key >> (8 * digit)) & 0xFF];
+        }
+
+        scratch.resize(count);
+        for (int digit = 0; digit < 8; ++digit)
+        {
+            size_t* histogram = histograms[digit];
+            const int shift = 8 * digit;
+            if (histogram[(entries[0].key >> shift) & 0xFF] == count)
+                continue;
+
+            size_t offset = 0;
+            for (int bucket = 0; bucket < 256; ++bucket)
+            {
+                const size_t n = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += n;
+            }
+            for (const Entry& entry : entries)
+                scratch[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+            entries.swap(scratch);
+        }
+    }
+
+    std::vector<DrawItem> items_;
+    std::vector<Entry> entries_;
+    std::vector<Entry> scratch_;
+    std::vector<UniformBlocks::ObjectConstants> objects_;
+};
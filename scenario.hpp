@@ -0,0 +1,198 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include "fish_pool.hpp"
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class SizeDistribution
+{
+    kUniform,   // Lengths spread evenly over [minLength, maxLength]
+    kNormal     // Bell curve centred on the middle of the range, clamped to it
+};
+
+// Everything that defines a generated world. The same settings (seed included)
+// always produce the same fish, whatever the thread count or machine: nothing
+// on the generation path calls libm (see cubeRoot, Random::normal and
+// FishMotion::atan2Poly).
+struct ScenarioSettings
+{
+    uint64_t seed = 1;
+    size_t schoolCount = 1;
+    size_t fishPerSchool = 10;
+
+    // Schools are kept inside this box, grown when several do not fit (see
+    // Scenario::fitHalfExtent); the defaults match the original hand-placed school
+    glm::vec3 center = glm::vec3(-0.5f, 3.0f, -13.0f);
+    glm::vec3 halfExtent = glm::vec3(2.5f, 2.0f, 3.0f);
+    float fishSpacing = 1.2f;       // Average distance between fish in a school
+
+    float minLength = 0.3f;
+    float maxLength = 0.5f;
+    SizeDistribution sizeDistribution = SizeDistribution::kUniform;
+    float bodyRatio = 0.6f;         // Height and width as a fraction of length
+
+    // Circular motion, used when schooling is off
+    glm::vec3 orbitCenter = glm::vec3(0.0f);
+    float angularSpeed = 0.1f;
+    float angularSpeedJitter = 0.03f;
+
+    size_t fishCount() const { return schoolCount * fishPerSchool; }
+
+    // Spreads about total fish over schools of at most schoolSize. The total is
+    // rounded up so every school gets the same number of fish.
+    void splitFish(size_t total, size_t schoolSize = 1000)
+    {
+        schoolSize = std::max<size_t>(schoolSize, 1);
+        schoolCount = std::max<size_t>((total + schoolSize - 1) / schoolSize, 1);
+        fishPerSchool = (total + schoolCount - 1) / schoolCount;
+    }
+};
+
+namespace Scenario
+{
+    // Counter-based generator (SplitMix64): every fish seeds its own stream
+    // from (seed, school, fish), so results do not depend on how the work is split
+    struct Random
+    {
+        uint64_t state;
+
+        Random(uint64_t seed, uint64_t a, uint64_t b)
+            : state(seed ^ (a * 0x9e3779b97f4a7c15ull) ^ (b * 0xc2b2ae3d27d4eb4full))
+        {
+            next();
+        }
+
+        uint64_t next()
+        {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+
+        // [0, 1) with 24 random bits
+        float unit()
+        {
+            return static_cast<float>(next() >> 40) * (1.0f / 16777216.0f);
+        }
+
+        // [-1, 1)
+        float signedUnit()
+        {
+            return unit() * 2.0f - 1.0f;
+        }
+
+        // Uniform point in the unit ball by rejection
+        glm::vec3 inUnitBall()
+        {
+            for (;;)
+            {
+                const glm::vec3 p(signedUnit(), signedUnit(), signedUnit());
+                if (glm::dot(p, p) <= 1.0f)
+                    return p;
+            }
+        }
+
+        // Approximately standard normal (sum of four uniforms, Irwin-Hall),
+        // avoiding libm so every platform produces the same bits
+        float normal()
+        {
+            return (unit() + unit() + unit() + unit() - 2.0f) * 1.7320508f;
+        }
+    };
+
+    // Cube root by Newton iteration, for the same reason
+    inline float cubeRoot(float v)
+    {
+        if (v <= 0.0f)
+            return 0.0f;
+        float x = std::max(v / 3.0f, 1.0f);
+        for (int i = 0; i < 64; ++i)
+            x -= (x * x * x - v) / (3.0f * x * x);
+        return x;
+    }
+
+    // Radius of the ball a school's fish are spread over
+    inline float schoolRadius(const ScenarioSettings& s)
+    {
+        return s.fishSpacing * cubeRoot(static_cast<float>(s.fishPerSchool));
+    }
+
+    // Half extent of the box schools are actually placed in. A single school
+    // keeps s.halfExtent. Several schools get room to spread over at least one
+    // school radius each way on every axis, and a box that holds at least their
+    // combined volume, so large counts do not pile up on one centre or plane.
+    inline glm::vec3 fitHalfExtent(const ScenarioSettings& s)
+    {
+        if (s.schoolCount <= 1)
+            return s.halfExtent;
+        const float radius = schoolRadius(s);
+        glm::vec3 halfExtent = glm::max(s.halfExtent, glm::vec3(2.0f * radius));
+        const float schoolsVolume = static_cast<float>(s.schoolCount) * 4.18879020f * radius * radius * radius;
+        const float boxVolume = 8.0f * halfExtent.x * halfExtent.y * halfExtent.z;
+        if (boxVolume < schoolsVolume)
+            halfExtent *= cubeRoot(schoolsVolume / boxVolume);
+        return halfExtent;
+    }
+
+    inline float sampleLength(const ScenarioSettings& s, Random& rng)
+    {
+        const float range = s.maxLength - s.minLength;
+        if (s.sizeDistribution == SizeDistribution::kNormal)
+        {
+            const float length = s.minLength + range * 0.5f + rng.normal() * range / 6.0f;
+            return glm::clamp(length, s.minLength, s.maxLength);
+        }
+        return s.minLength + rng.unit() * range;
+    }
+
+    struct School
+    {
+        glm::vec3 center;
+        float radius;
+        float angularSpeed;
+    };
+
+    // Replaces the contents of the pool with the scenario. Schools are laid
+    // out serially (there are few); the fish are filled in parallel.
+    inline void generate(const ScenarioSettings& s, FishPool& fishes, JobSystem& jobs)
+    {
+        const size_t perSchool = s.fishPerSchool;
+        const float radius = schoolRadius(s);
+        const glm::vec3 room = glm::max(fitHalfExtent(s) - glm::vec3(radius), glm::vec3(0.0f));
+
+        std::vector<School> schools(s.schoolCount);
+        for (size_t k = 0; k < schools.size(); ++k)
+        {
+            Random rng(s.seed, k, UINT64_MAX);
+            schools[k].center = s.center + room * glm::vec3(rng.signedUnit(), rng.signedUnit(), rng.signedUnit());
+            schools[k].radius = radius;
+            schools[k].angularSpeed = s.angularSpeed + s.angularSpeedJitter * rng.signedUnit();
+        }
+
+        fishes.clear();
+        fishes.reserve(s.fishCount());
+        const size_t first = fishes.grow(s.fishCount());
+
+        jobs.parallelFor(0, s.fishCount(), 8192, [&](size_t begin, size_t end)
+        {
+            for (size_t n = begin; n < end; ++n)
+            {
+                const size_t k = n / perSchool;
+                const School& school = schools[k];
+                Random rng(s.seed, k, n - k * perSchool);
+
+                const glm::vec3 position = school.center + school.radius * rng.inUnitBall();
+                const float length = sampleLength(s, rng);
+                const glm::vec3 fishScale(length, length * s.bodyRatio, length * s.bodyRatio);
+                fishes.set(first + n, position, fishScale, s.orbitCenter, school.angularSpeed);
+            }
+        });
+    }
+}
@@ -2,17 +2,173 @@
 
 #include <glad/glad.h>
 
+#include <glm.hpp>
+#include <gtc/type_ptr.hpp>
+
+#include "gl_state.hpp"
+#include "vertex_layout.hpp"
+
+#include <initializer_list>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// How a C++ type is written to a plain uniform, and which GLSL types accept it
+template <typename T>
+struct UniformTraits;
+
+template <>
+struct UniformTraits<bool>
+{
+    static constexpr const char* name = "bool";
+    static bool accepts(GLenum type) { return type == GL_BOOL; }
+    static void set(GLint location, bool value) { glUniform1i(location, (int)value); }
+};
+
+// Also used for samplers, which take a texture unit
+template <>
+struct UniformTraits<int>
+{
+    static constexpr const char* name = "int or sampler";
+    static bool accepts(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_INT:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_2D_ARRAY:
+            return true;
+        default:
+            return false;
+        }
+    }
+    static void set(GLint location, int value) { glUniform1i(location, value); }
+};
+
+template <>
+struct UniformTraits<float>
+{
+    static constexpr const char* name = "float";
+    static bool accepts(GLenum type) { return type == GL_FLOAT; }
+    static void set(GLint location, float value) { glUniform1f(location, value); }
+};
+
+template <>
+struct UniformTraits<glm::vec2>
+{
+    static constexpr const char* name = "vec2";
+    static bool accepts(GLenum type) { return type == GL_FLOAT_VEC2; }
+    static void set(GLint location, const glm::vec2& value) { glUniform2f(location, value.x, value.y); }
+};
+
+template <>
+struct UniformTraits<glm::vec3>
+{
+    static constexpr const char* name = "vec3";
+    static bool accepts(GLenum type) { return type == GL_FLOAT_VEC3; }
+    static void set(GLint location, const glm::vec3& value) { glUniform3f(location, value.x, value.y, value.z); }
+};
+
+template <>
+struct UniformTraits<glm::vec4>
+{
+    static constexpr const char* name = "vec4";
+    static bool accepts(GLenum type) { return type == GL_FLOAT_VEC4; }
+    static void set(GLint location, const glm::vec4& value) { glUniform4f(location, value.x, value.y, value.z, value.w); }
+};
+
+template <>
+struct UniformTraits<glm::mat3>
+{
+    static constexpr const char* name = "mat3";
+    static bool accepts(GLenum type) { return type == GL_FLOAT_MAT3; }
+    static void set(GLint location, const glm::mat3& value) { glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+};
 
+template <>
+struct UniformTraits<glm::mat4>
+{
+    static constexpr const char* name = "mat4";
+    static bool accepts(GLenum type) { return type == GL_FLOAT_MAT4; }
+    static void set(GLint location, const glm::mat4& value) { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+};
+
+// A plain uniform of one program, looked up once by Shader::uniform<T>().
+// set() is a single glUniform* on the cached location and, like glUniform*,
+// writes to the program currently in use. A default (invalid) handle does nothing.
+template <typename T>
+class UniformHandle
+{
+public:
+    UniformHandle() = default;
+    explicit UniformHandle(GLint location) : location_(location) {}
+
+    void set(const T& value) const
+    {
+        if (location_ >= 0)
+            UniformTraits<T>::set(location_, value);
+    }
+
+    bool valid() const { return location_ >= 0; }
+    GLint location() const { return location_; }
+
+private:
+    GLint location_ = -1;
+};
+
+// GLSL program built from a vertex and a fragment shader file.
+//
+// After linking, the program's active uniforms and uniform blocks are read
+// back once (glGetActiveUniform / glGetActiveUniformBlockName) into hash
+// tables. Callers fetch typed handles at startup and set through them per
+// frame without any string work:
+//
+//   UniformHandle<glm::vec3> topColor = backgroundShader.uniform<glm::vec3>("topColor");
+//   backgroundShader.use();
+//   topColor.set(glm::vec3(0.0f, 0.3f, 0.5f));
+//
+// Compile and link errors, unknown uniform names and type mismatches are
+// reported when they happen and counted in Shader::errorCount(), so the
+// application can refuse to start rather than draw with a silently ignored
+// uniform. GLSL drops uniforms that do not affect the output, so a declared
+// but unused uniform counts as unknown too; use findUniform() for optional ones.
+//
+// Active vertex inputs are read back as well, so checkVertexInputs() can
+// compare them with the VertexLayout formats a draw will bind.
 class Shader
 {
 public:
+    struct UniformInfo
+    {
+        GLint location;     // -1 for members of a uniform block
+        GLenum type;        // GL_FLOAT_VEC3, GL_SAMPLER_2D, ...
+        GLint size;         // Array length, 1 for non-arrays
+        GLint block;        // Uniform block index, -1 for plain uniforms
+    };
+
+    struct BlockInfo
+    {
+        GLuint index;
+        GLint dataSize;     // Bytes the bound buffer range must cover
+    };
+
+    struct AttributeInfo
+    {
+        std::string name;
+        GLint location;
+        GLenum type;        // GL_FLOAT_VEC3, GL_INT, ...
+    };
+
     unsigned int ID;
 
     Shader(const char* vertexPath, const char* fragmentPath)
+        : label_(std::string(vertexPath) + " + " + fragmentPath)
     {
         std::string vertexCode;
         std::string fragmentCode;
@@ -38,7 +194,7 @@ public:
         }
         catch (std::ifstream::failure& e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+            reportError(std::string("FILE_NOT_SUCCESFULLY_READ: ") + e.what());
         }
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
@@ -48,59 +204,224 @@ public:
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
 
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
+        checkCompileErrors(fragment, "FRAGMENT");
 
         ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
+        checkLinkErrors();
 
         glDeleteShader(vertex);
         glDeleteShader(fragment);
+
+        reflect();
     }
     ~Shader()
     {
         glDeleteProgram(ID);
     }
 
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
     void use()
     {
-        glUseProgram(ID);
+        GlState::current().useProgram(ID);
+    }
+
+    // Handle to a plain uniform; an unknown name or a type that does not
+    // match the GLSL declaration is reported and yields an invalid handle
+    template <typename T>
+    UniformHandle<T> uniform(const std::string& name) const
+    {
+        const UniformInfo* info = findUniform(name);
+        if (!info)
+        {
+            reportError("UNIFORM_NOT_FOUND: \"" + name + "\" (active uniforms:" + activeUniformNames() + ")");
+            return UniformHandle<T>();
+        }
+        if (info->block >= 0)
+        {
+            reportError("UNIFORM_IN_BLOCK: \"" + name + "\" is a uniform block member, set it through the block's buffer");
+            return UniformHandle<T>();
+        }
+        if (!UniformTraits<T>::accepts(info->type))
+        {
+            reportError("UNIFORM_TYPE_MISMATCH: \"" + name + "\" is not a " + UniformTraits<T>::name);
+            return UniformHandle<T>();
+        }
+        return UniformHandle<T>(info->location);
     }
 
-    void setBool(const std::string& name, bool value) const
+    // Active uniform by name (array uniforms without "[0]"), or nullptr
+    const UniformInfo* findUniform(const std::string& name) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        const auto it = uniforms_.find(name);
+        return it != uniforms_.end() ? &it->second : nullptr;
     }
 
-    void setInt(const std::string& name, int value) const
+    // Active uniform block by name, or nullptr
+    const BlockInfo* findBlock(const std::string& name) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        const auto it = blocks_.find(name);
+        return it != blocks_.end() ? &it->second : nullptr;
     }
 
-    void setFloat(const std::string& name, float value) const
+    const std::vector<AttributeInfo>& attributes() const { return attributes_; }
+
+    // Reports every active vertex input that formats (the VAO's vertex and
+    // instance formats together) do not provide, or provide as float where
+    // the shader reads integers or the other way round. what names the draw.
+    void checkVertexInputs(std::initializer_list<VertexLayout::FormatInfo> formats, const std::string& what) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        for (const AttributeInfo& input : attributes_)
+        {
+            const VertexLayout::AttributeInfo* provided = nullptr;
+            for (const VertexLayout::FormatInfo& format : formats)
+            {
+                for (size_t i = 0; i < format.count && !provided; ++i)
+                {
+                    if (static_cast<GLint>(format.attributes[i].location) == input.location)
+                        provided = &format.attributes[i];
+                }
+            }
+            if (!provided)
+            {
+                reportError("VERTEX_INPUT_NOT_PROVIDED: \"" + input.name + "\" at location " + std::to_string(input.location)
+                            + " by the vertex format of " + what);
+            }
+            else if ((provided->fetch == VertexLayout::kInteger) != isIntegerType(input.type))
+            {
+                reportError("VERTEX_INPUT_TYPE_MISMATCH: \"" + input.name + "\" is read as "
+                            + (isIntegerType(input.type) ? "integer" : "float") + " but the vertex format of " + what
+                            + " provides " + (provided->fetch == VertexLayout::kInteger ? "integer" : "float") + " data");
+            }
+        }
     }
 
-    void setMat4(const std::string& name, glm::mat4 value) const
+    const std::string& label() const { return label_; }
+
+    // Prints an error about this program and counts it in errorCount()
+    void reportError(const std::string& message) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+        std::cerr << "ERROR::SHADER::" << message << " in " << label_ << std::endl;
+        ++errors();
     }
-    void setVec2(const std::string& name, glm::vec2 vec2) const
+
+    // Errors reported by any Shader so far
+    static unsigned errorCount() { return errors(); }
+
+private:
+    static unsigned& errors()
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), vec2.x, vec2.y);
+        static unsigned count = 0;
+        return count;
     }
 
-    void setVec3(const std::string& name, float f0, float f1, float f2) const
+    void checkCompileErrors(unsigned int shader, const char* type) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), f0, f1, f2);
+        GLint success = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            GLchar infoLog[1024];
+            glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+            reportError(std::string(type) + "_COMPILATION_FAILED:\n" + infoLog);
+        }
     }
-    void setVec3(const std::string& name, glm::vec3 vec3) const
+
+    void checkLinkErrors() const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), vec3.x, vec3.y, vec3.z);
+        GLint success = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            GLchar infoLog[1024];
+            glGetProgramInfoLog(ID, sizeof(infoLog), NULL, infoLog);
+            reportError(std::string("PROGRAM_LINKING_FAILED:\n") + infoLog);
+        }
     }
-};
\ No newline at end of file
+
+    void reflect()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+        for (GLuint i = 0; i < static_cast<GLuint>(count); ++i)
+        {
+            GLsizei length = 0;
+            UniformInfo info;
+            glGetActiveUniform(ID, i, static_cast<GLsizei>(buffer.size()), &length, &info.size, &info.type, buffer.data());
+            glGetActiveUniformsiv(ID, 1, &i, GL_UNIFORM_BLOCK_INDEX, &info.block);
+
+            std::string name(buffer.data(), length);
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+                name.resize(name.size() - 3);
+            info.location = info.block < 0 ? glGetUniformLocation(ID, name.c_str()) : -1;
+            uniforms_.emplace(std::move(name), info);
+        }
+
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &count);
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+        buffer.resize(maxLength > 0 ? maxLength : 1);
+        for (GLuint i = 0; i < static_cast<GLuint>(count); ++i)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            AttributeInfo info;
+            glGetActiveAttrib(ID, i, static_cast<GLsizei>(buffer.size()), &length, &size, &info.type, buffer.data());
+            info.name.assign(buffer.data(), length);
+            info.location = glGetAttribLocation(ID, info.name.c_str());
+            if (info.location >= 0)     // gl_VertexID and friends have none
+                attributes_.push_back(info);
+        }
+
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+        buffer.resize(maxLength > 0 ? maxLength : 1);
+        for (GLuint i = 0; i < static_cast<GLuint>(count); ++i)
+        {
+            GLsizei length = 0;
+            glGetActiveUniformBlockName(ID, i, static_cast<GLsizei>(buffer.size()), &length, buffer.data());
+            BlockInfo info;
+            info.index = i;
+            glGetActiveUniformBlockiv(ID, i, GL_UNIFORM_BLOCK_DATA_SIZE, &info.dataSize);
+            blocks_.emplace(std::string(buffer.data(), length), info);
+        }
+    }
+
+    static bool isIntegerType(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_INT: case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+        case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    std::string activeUniformNames() const
+    {
+        std::string names;
+        for (const auto& uniform : uniforms_)
+        {
+            if (uniform.second.block < 0)
+                names += " " + uniform.first;
+        }
+        return names;
+    }
+
+    std::string label_;     // "vertex path + fragment path", for error messages
+    std::unordered_map<std::string, UniformInfo> uniforms_;
+    std::unordered_map<std::string, BlockInfo> blocks_;
+    std::vector<AttributeInfo> attributes_;
+};
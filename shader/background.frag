@@ -5,9 +5,22 @@ in vec2 TexCoords;
 
 uniform vec3 topColor;         // Top background color
 uniform vec3 bottomColor;      // Bottom background color
-uniform float time;            // Time(for dynamic)
 uniform vec3 sunPosition;      // Sunshine simulation
 
+// Per-frame data, see UniformBlocks::FrameConstants in uniform_blocks.hpp
+layout(std140) uniform FrameConstants
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;           // Camera position
+    float time;             // Seconds since start
+    vec3 ambientLight;      // Ambient light color
+    float fogDensity;       // Fog density control
+    vec3 lightColor;        // Light source color
+    vec3 lightDir;          // Light source direction (directional light)
+    vec3 fogColor;          // Fog color
+};
+
 void main() 
 {
     // Water simulation
@@ -0,0 +1,86 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 AtlasCoords;
+in vec3 FragPos;
+flat in vec2 Heading;
+flat in vec3 Scale;
+
+uniform sampler2D impostorAlbedo;   // Baked texture color, alpha = coverage
+uniform sampler2D impostorNormal;   // Baked mesh-space normal
+
+// Per-frame data, see UniformBlocks::FrameConstants in uniform_blocks.hpp
+layout(std140) uniform FrameConstants
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;           // Camera position
+    float time;             // Seconds since start
+    vec3 ambientLight;      // Ambient light color
+    float fogDensity;       // Fog density control
+    vec3 lightColor;        // Light source color
+    vec3 lightDir;          // Light source direction (directional light)
+    vec3 fogColor;          // Fog color
+};
+
+// Per-draw data, see UniformBlocks::ObjectConstants
+layout(std140) uniform ObjectConstants
+{
+    mat4 model;
+    bool isShark;
+    int meshID;
+    float impostorFadeStart;    // Crossfade band shared with model.frag:
+    float impostorFadeEnd;      // impostors draw the pixels the meshes drop
+    float swayMultiplier;       // Shark sway strength
+};
+
+float bayer4(vec2 fragCoord)
+{
+    const float matrix[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0,
+                                       3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 p = ivec2(mod(fragCoord, 4.0));
+    return (matrix[p.x + 4 * p.y] + 0.5) / 16.0;
+}
+
+void main()
+{
+    vec4 texColor = texture(impostorAlbedo, AtlasCoords);
+    if (texColor.a < 0.5)
+        discard;
+
+    float distance = length(viewPos - FragPos);
+    if (bayer4(gl_FragCoord.xy) >= smoothstep(impostorFadeStart, impostorFadeEnd, distance))
+        discard;
+
+    // Mesh-space normal to world space, as in model_instanced.vert
+    mat3 rotation = mat3(vec3(Heading.y, 0.0, -Heading.x),
+                         vec3(0.0, 1.0, 0.0),
+                         vec3(Heading.x, 0.0, Heading.y));
+    vec3 meshNormal = texture(impostorNormal, AtlasCoords).xyz * 2.0 - 1.0;
+    vec3 norm = normalize(rotation * (meshNormal / Scale));
+
+    // Lighting and fog as in model.frag
+    vec3 ambient = ambientLight * texColor.rgb;
+
+    vec3 dirLight = normalize(-lightDir);
+    float diff = max(dot(norm, dirLight), 0.0);
+    vec3 diffuse = diff * lightColor * texColor.rgb;
+
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 reflectDir = reflect(-dirLight, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
+    vec3 specular = lightColor * spec * 0.6;
+
+    float scatterFactor = pow(dot(norm, dirLight), 2.0);
+    vec3 scatteredLight = lightColor * scatterFactor;
+
+    float attenuation = 1.0 / (1.0 + 0.1 * distance);
+    diffuse *= attenuation;
+    specular *= attenuation;
+    scatteredLight *= attenuation;
+
+    vec3 result = ambient + diffuse + specular + scatteredLight;
+
+    float fogFactor = clamp(exp(-pow(distance * fogDensity, 2.0)), 0.0, 1.0);
+    FragColor = vec4(mix(fogColor, result, fogFactor), 1.0);
+}
@@ -0,0 +1,83 @@
+#version 330 core
+// Per-instance data (one entry per fish, see FishInstance in fish_renderer.hpp)
+layout(location = 7) in vec4 iPositionHeadingX;  // World position, heading x
+layout(location = 8) in vec4 iScaleHeadingZ;     // Scale, heading z
+
+out vec2 AtlasCoords;     // Into the impostor atlas
+out vec3 FragPos;         // Fragment position on the quad, world space
+flat out vec2 Heading;    // For turning the baked normal into world space
+flat out vec3 Scale;
+
+// Per-frame data, see UniformBlocks::FrameConstants in uniform_blocks.hpp
+layout(std140) uniform FrameConstants
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;           // Camera position
+    float time;             // Seconds since start
+    vec3 ambientLight;      // Ambient light color
+    float fogDensity;       // Fog density control
+    vec3 lightColor;        // Light source color
+    vec3 lightDir;          // Light source direction (directional light)
+    vec3 fogColor;          // Fog color
+};
+
+// Atlas layout, see FishImpostors in impostor.hpp
+uniform vec3 boundsCenter;    // Mesh-space bounding sphere the views were framed on
+uniform float boundsRadius;
+uniform int framesPerSide;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Same mapping as FishImpostors::octEncode / octDecode
+vec2 octEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 p = n.xz;
+    if (n.y < 0.0)
+        p = (1.0 - abs(p.yx)) * signNotZero(p);
+    return p;
+}
+
+vec3 octDecode(vec2 p)
+{
+    vec3 n = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+    if (n.y < 0.0)
+        n.xz = (1.0 - abs(n.zx)) * signNotZero(n.xz);
+    return normalize(n);
+}
+
+void main()
+{
+    // Same matrix as FishPool::modelMatrix: translate * rotateY(heading) * scale
+    float hx = iPositionHeadingX.w;
+    float hz = iScaleHeadingZ.w;
+    mat3 rotation = mat3(vec3(hz, 0.0, -hx),
+                         vec3(0.0, 1.0, 0.0),
+                         vec3(hx, 0.0, hz));
+    vec3 scale = iScaleHeadingZ.xyz;
+    vec3 position = iPositionHeadingX.xyz;
+
+    // Direction towards the camera in mesh space, snapped to the nearest baked view
+    vec3 eye = (transpose(rotation) * (viewPos - position)) / scale;
+    vec2 cell = clamp(floor((octEncode(normalize(eye - boundsCenter)) * 0.5 + 0.5) * float(framesPerSide)),
+                      vec2(0.0), vec2(float(framesPerSide - 1)));
+    vec3 direction = octDecode((cell + 0.5) / float(framesPerSide) * 2.0 - 1.0);
+
+    // The baked camera's basis (glm::lookAt with +y up, +z when looking straight up or down)
+    vec3 up = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(up, direction));
+    up = cross(direction, right);
+
+    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0 - 1.0;
+    vec3 local = boundsCenter + (corner.x * right + corner.y * up) * boundsRadius;
+
+    AtlasCoords = (cell + corner * 0.5 + 0.5) / float(framesPerSide);
+    FragPos = position + rotation * (local * scale);
+    Heading = vec2(hx, hz);
+    Scale = scale;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
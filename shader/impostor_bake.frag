@@ -0,0 +1,14 @@
+#version 330 core
+layout(location = 0) out vec4 Albedo;     // Texture color, alpha = coverage
+layout(location = 1) out vec4 NormalOut;  // Mesh-space normal packed into [0, 1]
+
+in vec2 TexCoords;
+in vec3 Normal;
+
+uniform sampler2D texture_diffuse;
+
+void main()
+{
+    Albedo = vec4(texture(texture_diffuse, TexCoords).rgb, 1.0);
+    NormalOut = vec4(normalize(Normal) * 0.5 + 0.5, 1.0);
+}
@@ -0,0 +1,31 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;        // Vertex position
+layout(location = 1) in vec3 aNormal;     // Vertex normal
+layout(location = 2) in vec2 aTexCoords;  // Vertex texture coordinates
+layout(location = 9) in vec4 aPositionBounds; // Mesh centre and half extent, see quantized_vertex.hpp
+
+out vec2 TexCoords;   // Pass texture coordinates
+out vec3 Normal;      // Pass mesh-space normal
+
+// Set per atlas cell while baking, see UniformBlocks::FrameConstants in uniform_blocks.hpp
+layout(std140) uniform FrameConstants
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;           // Camera position
+    float time;             // Seconds since start
+    vec3 ambientLight;      // Ambient light color
+    float fogDensity;       // Fog density control
+    vec3 lightColor;        // Light source color
+    vec3 lightDir;          // Light source direction (directional light)
+    vec3 fogColor;          // Fog color
+};
+
+void main()
+{
+    // Baked in mesh space; the fish's own transform is applied when the impostor is drawn
+    TexCoords = aTexCoords;
+    Normal = aNormal;
+    vec3 position = aPositionBounds.xyz + aPos * aPositionBounds.w;  // Undo the 16-bit quantization
+    gl_Position = projection * view * vec4(position, 1.0);
+}
@@ -6,17 +6,48 @@ in vec3 Normal;      // Normal vector passed in
 in vec3 FragPos;     // Fragment position in world space
 
 uniform sampler2D texture_diffuse; // Texture sampler
-uniform vec3 ambientLight;         // Ambient light color
-uniform vec3 lightColor;           // Light source color
-uniform vec3 lightDir;             // Light source direction (directional light)
-uniform vec3 viewPos;              // Camera position
 
-// Fog-related uniforms
-uniform float fogDensity;          // Fog density control
-uniform vec3 fogColor;             // Fog color
+// Per-frame data, see UniformBlocks::FrameConstants in uniform_blocks.hpp
+layout(std140) uniform FrameConstants
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;           // Camera position
+    float time;             // Seconds since start
+    vec3 ambientLight;      // Ambient light color
+    float fogDensity;       // Fog density control
+    vec3 lightColor;        // Light source color
+    vec3 lightDir;          // Light source direction (directional light)
+    vec3 fogColor;          // Fog color
+};
+
+// Per-draw data, see UniformBlocks::ObjectConstants
+layout(std140) uniform ObjectConstants
+{
+    mat4 model;
+    bool isShark;
+    int meshID;
+    float impostorFadeStart;    // Far fish crossfade into impostors over this
+    float impostorFadeEnd;      // distance band; 0, 0 for everything else
+    float swayMultiplier;       // Shark sway strength
+};
+
+// Ordered dither threshold in [0, 1) for screen-door fading
+float bayer4(vec2 fragCoord)
+{
+    const float matrix[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0,
+                                       3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 p = ivec2(mod(fragCoord, 4.0));
+    return (matrix[p.x + 4 * p.y] + 0.5) / 16.0;
+}
 
 void main()
 {
+    // Drop the pixels the impostor takes over
+    if (impostorFadeEnd > impostorFadeStart
+        && bayer4(gl_FragCoord.xy) < smoothstep(impostorFadeStart, impostorFadeEnd, length(viewPos - FragPos)))
+        discard;
+
     // Sample color from the texture
     vec4 texColor = texture(texture_diffuse, TexCoords);
 
@@ -2,30 +2,48 @@
 layout(location = 0) in vec3 aPos;        // Vertex position
 layout(location = 1) in vec3 aNormal;     // Vertex normal
 layout(location = 2) in vec2 aTexCoords;  // Vertex texture coordinates
+layout(location = 9) in vec4 aPositionBounds; // Mesh centre and half extent, see quantized_vertex.hpp
 
 out vec2 TexCoords;   // Pass texture coordinates
 out vec3 Normal;      // Pass normal
 out vec3 FragPos;     // Pass fragment position
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Per-frame data, see UniformBlocks::FrameConstants in uniform_blocks.hpp
+layout(std140) uniform FrameConstants
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;           // Camera position
+    float time;             // Seconds since start
+    vec3 ambientLight;      // Ambient light color
+    float fogDensity;       // Fog density control
+    vec3 lightColor;        // Light source color
+    vec3 lightDir;          // Light source direction (directional light)
+    vec3 fogColor;          // Fog color
+};
 
-uniform float time;
-uniform bool isShark;
-uniform int meshID;
+// Per-draw data, see UniformBlocks::ObjectConstants
+layout(std140) uniform ObjectConstants
+{
+    mat4 model;
+    bool isShark;
+    int meshID;
+    float impostorFadeStart;    // Far fish crossfade into impostors over this
+    float impostorFadeEnd;      // distance band; 0, 0 for everything else
+    float swayMultiplier;       // Shark sway strength
+};
 
 void main()
 {
-    vec3 modified_position = aPos;
+    vec3 position = aPositionBounds.xyz + aPos * aPositionBounds.w;  // Undo the 16-bit quantization
+    vec3 modified_position = position;
 
     if (isShark) {
-        float swayMultiplier = 1.5;
         float bodySway = sin(time * 2.5) * 0.7 + cos(time * 1.5) * 0.3;
-        float influence = smoothstep(0.0, 1.0, abs(aPos.x) / 5.0);
-        modified_position.z += swayMultiplier * bodySway * influence * sign(aPos.x);
+        float influence = smoothstep(0.0, 1.0, abs(position.x) / 5.0);
+        modified_position.z += swayMultiplier * bodySway * influence * sign(position.x);
 
-        float verticalSway = cos(time * 1.5 + aPos.x * 0.2) * 0.15;
+        float verticalSway = cos(time * 1.5 + position.x * 0.2) * 0.15;
         modified_position.y += swayMultiplier * verticalSway * influence;
 
         if (meshID == 1) {
@@ -0,0 +1,44 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;        // Vertex position
+layout(location = 1) in vec3 aNormal;     // Vertex normal
+layout(location = 2) in vec2 aTexCoords;  // Vertex texture coordinates
+layout(location = 9) in vec4 aPositionBounds; // Mesh centre and half extent, see quantized_vertex.hpp
+
+// Per-instance data (one entry per fish, see FishInstance in fish_renderer.hpp)
+layout(location = 7) in vec4 iPositionHeadingX;  // World position, heading x
+layout(location = 8) in vec4 iScaleHeadingZ;     // Scale, heading z
+
+out vec2 TexCoords;   // Pass texture coordinates
+out vec3 Normal;      // Pass normal
+out vec3 FragPos;     // Pass fragment position
+
+// Per-frame data, see UniformBlocks::FrameConstants in uniform_blocks.hpp
+layout(std140) uniform FrameConstants
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;           // Camera position
+    float time;             // Seconds since start
+    vec3 ambientLight;      // Ambient light color
+    float fogDensity;       // Fog density control
+    vec3 lightColor;        // Light source color
+    vec3 lightDir;          // Light source direction (directional light)
+    vec3 fogColor;          // Fog color
+};
+
+void main()
+{
+    // Same matrix as FishPool::modelMatrix: translate * rotateY(heading) * scale
+    float hx = iPositionHeadingX.w;
+    float hz = iScaleHeadingZ.w;
+    mat3 rotation = mat3(vec3(hz, 0.0, -hx),
+                         vec3(0.0, 1.0, 0.0),
+                         vec3(hx, 0.0, hz));
+    vec3 scale = iScaleHeadingZ.xyz;
+
+    TexCoords = aTexCoords;
+    Normal = rotation * (aNormal / scale); // Inverse transpose of rotation * scale
+    vec3 position = aPositionBounds.xyz + aPos * aPositionBounds.w;  // Undo the 16-bit quantization
+    FragPos = iPositionHeadingX.xyz + rotation * (position * scale);
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -1,10 +1,21 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 9) in vec4 aPositionBounds; // Mesh centre and half extent, see quantized_vertex.hpp
 
 uniform mat4 lightSpaceMatrix;
-uniform mat4 model;
+
+// Per-draw data, see UniformBlocks::ObjectConstants
+layout(std140) uniform ObjectConstants
+{
+    mat4 model;
+    bool isShark;
+    int meshID;
+    float impostorFadeStart;    // Far fish crossfade into impostors over this
+    float impostorFadeEnd;      // distance band; 0, 0 for everything else
+    float swayMultiplier;       // Shark sway strength
+};
 
 void main()
 {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
+    gl_Position = lightSpaceMatrix * model * vec4(aPositionBounds.xyz + aPos * aPositionBounds.w, 1.0);
 }
@@ -0,0 +1,77 @@
+#pragma once
+
+// Runtime CPU feature detection shared by the SIMD kernels.
+// Kernels are compiled for every level and one is picked at startup, so the
+// binary never needs /arch:AVX2 (or -mavx2) and still runs on older CPUs.
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SHARK_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) || !defined(SHARK_SIMD_X86)
+#define SHARK_TARGET_SSE41
+#define SHARK_TARGET_AVX2
+#else
+#define SHARK_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SHARK_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+enum class SimdLevel
+{
+    kScalar,
+    kSSE41,
+    kAVX2
+};
+
+inline const char* simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::kSSE41: return "SSE4.1";
+    case SimdLevel::kAVX2:  return "AVX2";
+    default:                return "Scalar";
+    }
+}
+
+inline SimdLevel detectSimdLevel()
+{
+#if defined(SHARK_SIMD_X86) && defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 1);
+    const bool sse41 = (regs[2] & (1 << 19)) != 0;
+    const bool fma = (regs[2] & (1 << 12)) != 0;
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    const bool avx = (regs[2] & (1 << 28)) != 0;
+
+    bool avx2 = false;
+    if (osxsave && avx && fma && (_xgetbv(0) & 0x6) == 0x6)
+    {
+        __cpuidex(regs, 7, 0);
+        avx2 = (regs[1] & (1 << 5)) != 0;
+    }
+
+    if (avx2)  return SimdLevel::kAVX2;
+    if (sse41) return SimdLevel::kSSE41;
+    return SimdLevel::kScalar;
+#elif defined(SHARK_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SimdLevel::kAVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return SimdLevel::kSSE41;
+    return SimdLevel::kScalar;
+#else
+    return SimdLevel::kScalar;
+#endif
+}
+
+// Detected once, on first use
+inline SimdLevel cpuSimdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <glm.hpp>
+#include <gtc/constants.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include "broadphase.hpp"
+#include "fish_pool.hpp"
+#include "flock.hpp"
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Game simulation without any GL dependency: fish motion, shark steering and
+// the hunt/eat logic. The render loop (or the headless runner) calls step()
+// at a fixed rate and draws with interpolatedShark() / FishPool::modelMatrix(i, alpha).
+
+struct BoundingSphere
+{
+    glm::vec3 center;
+    float radius;
+};
+
+inline bool checkCollision(const BoundingSphere& sphere1, const BoundingSphere& sphere2)
+{
+    const glm::vec3 offset = sphere1.center - sphere2.center;
+    const float radiusSum = sphere1.radius + sphere2.radius;
+    return glm::dot(offset, offset) <= radiusSum * radiusSum;
+}
+
+// Continuous version of checkCollision for spheres moving in straight lines
+// over one tick: sphere A from a0 to a1, sphere B from b0 to b1. Returns true if
+// they touch during the tick, with timeOfImpact in [0, 1] the fraction of the
+// tick at first contact (0 if they already overlap at the start).
+inline bool sweepSpheres(const glm::vec3& a0, const glm::vec3& a1, const glm::vec3& b0, const glm::vec3& b1,
+                         float radiusSum, float& timeOfImpact)
+{
+    // Solve |d0 + t v| = radiusSum for the relative motion of A seen from B
+    const glm::vec3 d0 = a0 - b0;
+    const glm::vec3 v = (a1 - a0) - (b1 - b0);
+    const float c = glm::dot(d0, d0) - radiusSum * radiusSum;
+    if (c <= 0.0f)
+    {
+        timeOfImpact = 0.0f;
+        return true;
+    }
+
+    const float a = glm::dot(v, v);
+    const float b = glm::dot(d0, v);
+    if (a < 1e-12f || b >= 0.0f)
+        return false;   // Not moving relative to each other, or moving apart
+
+    const float discriminant = b * b - a * c;
+    if (discriminant < 0.0f)
+        return false;   // Closest approach stays outside radiusSum
+
+    const float t = (-b - std::sqrt(discriminant)) / a;
+    if (t > 1.0f)
+        return false;
+    timeOfImpact = t;
+    return true;
+}
+
+// Player controls sampled once per frame and applied on every tick
+struct SimInput
+{
+    float turn = 0.0f;              // Q = -1, E = +1
+    float pitch = 0.0f;             // C = -1, Z = +1
+    bool toggleSchooling = false;   // Consumed by the next tick
+};
+
+struct SharkState
+{
+    glm::vec3 position = glm::vec3(-10.0f, 2.0f, 10.0f);
+    float directionAngle = -60.0f;  // Default direction of shark
+    float pitchAngle = 10.0f;       // Angle of up & down
+    float speed = 0.4f;             // Default shark speed
+    float turnSpeed = 10.0f;        // Turning speed
+    float verticalTurnSpeed = 5.0f; // Up & Down speed
+    bool hunting = false;           // A fish is inside the hunt sphere
+
+    glm::mat4 modelMatrix() const
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, position);
+        model = glm::rotate(model, glm::radians(-directionAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::rotate(model, glm::radians(pitchAngle), glm::vec3(0.0f, 0.0f, 1.0f));
+        model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
+        return model;
+    }
+};
+
+// Timings of the last step() in milliseconds
+struct SimStats
+{
+    double inputMs = 0.0;
+    double fishMs = 0.0;
+    double huntMs = 0.0;
+    double sharkMs = 0.0;
+};
+
+class Simulation
+{
+public:
+    FishPool fishes;
+    FlockSimulation flock;
+    FishBroadphase broadphase;      // Candidate fish for the shark spheres
+
+    SharkState shark;
+    SharkState previousShark;
+    BoundingSphere sharkBoundingSphere1 = { glm::vec3(0.0f), 12.0f };  // Hunt radius
+    BoundingSphere sharkBoundingSphere2 = { glm::vec3(0.0f), 2.0f };   // Bite radius
+
+    float speedBoostTimer = 0.0f;
+    bool isSpeedBoostActive = false;
+    bool hunted = false;
+    bool schoolingEnabled = true;
+    bool respawnEaten = false;      // Put an eaten fish back on the far side of its orbit
+    size_t fishEaten = 0;
+    float lastBiteTime = 0.0f;      // Fraction of the tick at which the last fish was caught
+
+    double time = 0.0;              // Simulated seconds
+    long long tick = 0;
+
+    explicit Simulation(JobSystem& jobs) : jobs_(jobs)
+    {
+        sharkBoundingSphere1.center = shark.position;
+        sharkBoundingSphere2.center = shark.position;
+        previousShark = shark;
+    }
+
+    const SimStats& stats() const { return stats_; }
+
+    // Upper bound on how far any fish moved during the last tick, so also on how
+    // far an interpolated pose can be from the current position
+    float maxFishStep() const { return lastFishStep_; }
+
+    void step(float deltaTime, const SimInput& input)
+    {
+        using Clock = std::chrono::steady_clock;
+        const auto t0 = Clock::now();
+
+        fishes.storePrevious();
+        previousShark = shark;
+
+        applyInput(deltaTime, input);
+        updateSpeedBoost(deltaTime);
+        const auto t1 = Clock::now();
+        updateFish(deltaTime);
+        const auto t2 = Clock::now();
+        updateShark(deltaTime);
+        const auto t3 = Clock::now();
+        updateHunt(deltaTime);
+        const auto t4 = Clock::now();
+
+        stats_.inputMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        stats_.fishMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        stats_.sharkMs = std::chrono::duration<double, std::milli>(t3 - t2).count();
+        stats_.huntMs = std::chrono::duration<double, std::milli>(t4 - t3).count();
+
+        time += deltaTime;
+        ++tick;
+    }
+
+    // Shark pose blended between the previous and the current tick
+    SharkState interpolatedShark(float alpha) const
+    {
+        SharkState blended = shark;
+        blended.position = glm::mix(previousShark.position, shark.position, alpha);
+        blended.directionAngle = glm::mix(previousShark.directionAngle, shark.directionAngle, alpha);
+        blended.pitchAngle = glm::mix(previousShark.pitchAngle, shark.pitchAngle, alpha);
+        return blended;
+    }
+
+private:
+    void applyInput(float deltaTime, const SimInput& input)
+    {
+        shark.directionAngle += input.turn * shark.turnSpeed * deltaTime;
+        shark.pitchAngle += input.pitch * shark.verticalTurnSpeed * deltaTime;
+
+        // Avoid flip upside down
+        shark.pitchAngle = glm::clamp(shark.pitchAngle, -30.0f, 30.0f);
+
+        if (input.toggleSchooling)
+        {
+            schoolingEnabled = !schoolingEnabled;
+
+            // Hand the current motion over to the other mode
+            if (schoolingEnabled)
+                fishes.resetVelocities();
+            else
+                fishes.resetOrbits();
+            orbitSpeedCount_ = SIZE_MAX;
+        }
+    }
+
+    void updateSpeedBoost(float deltaTime)
+    {
+        if (isSpeedBoostActive)
+        {
+            speedBoostTimer -= deltaTime;
+            if (speedBoostTimer <= 0.0f) {
+                isSpeedBoostActive = false;
+                speedBoostTimer = 0.0f;
+                hunted = false;
+            }
+        }
+    }
+
+    void updateFish(float deltaTime)
+    {
+        const float speedMultiplier = fishSpeedMultiplier();
+        if (schoolingEnabled)
+            flock.step(fishes, shark.position, deltaTime, speedMultiplier, &jobs_);
+        else
+            fishes.advance(deltaTime, speedMultiplier, jobs_);
+
+        lastFishStep_ = maxFishSpeed() * speedMultiplier * deltaTime;
+        broadphase.addDrift(lastFishStep_);
+    }
+
+    // Fish flee faster for a while after the shark has eaten
+    float fishSpeedMultiplier() const
+    {
+        return isSpeedBoostActive ? 3.5f : 1.0f;
+    }
+
+    // Upper bound on any fish's speed before the boost multiplier
+    float maxFishSpeed()
+    {
+        if (schoolingEnabled)
+            return flock.settings.maxSpeed;
+
+        // Orbits only change on a mode switch or when fish come and go
+        if (orbitSpeedCount_ != fishes.size())
+        {
+            maxOrbitSpeed_ = 0.0f;
+            for (size_t i = 0; i < fishes.size(); ++i)
+                maxOrbitSpeed_ = std::max(maxOrbitSpeed_, std::abs(fishes.angularSpeed[i]) * fishes.radius[i]);
+            orbitSpeedCount_ = fishes.size();
+        }
+        return maxOrbitSpeed_;
+    }
+
+    // Runs after both the fish and the shark have moved. The bite test sweeps
+    // both over the tick, so a fast shark or a long tick cannot skip past a fish.
+    void updateHunt(float deltaTime)
+    {
+        // Check if the shark should start hunting (speeds up the shark from the next tick)
+        shark.hunting = broadphase.anyOverlap(fishes, sharkBoundingSphere1.center, sharkBoundingSphere1.radius);
+        if (hunted || !shark.hunting)
+            return;
+
+        // Check if the shark can eat a fish: the earliest contact within the tick wins
+        const glm::vec3 from = previousShark.position;
+        const glm::vec3 to = shark.position;
+        const float biteRadius = sharkBoundingSphere2.radius;
+        const float fishStep = maxFishSpeed() * fishSpeedMultiplier() * deltaTime;
+        const float sweepRadius = biteRadius + 0.5f * glm::length(to - from) + fishStep;
+
+        size_t eaten = FishPool::npos;
+        float firstContact = 2.0f;
+        broadphase.forEachCandidate(fishes, 0.5f * (from + to), sweepRadius, [&](size_t i)
+        {
+            const glm::vec3 fishFrom(fishes.prevPosX[i], fishes.prevPosY[i], fishes.prevPosZ[i]);
+            float t;
+            if (sweepSpheres(from, to, fishFrom, fishes.position(i), biteRadius + fishes.boundingRadius[i], t)
+                && (t < firstContact || (t == firstContact && i < eaten)))
+            {
+                firstContact = t;
+                eaten = i;
+            }
+            return true;
+        });
+
+        if (eaten != FishPool::npos)
+        {
+            lastBiteTime = firstContact;
+            eatFish(eaten);
+            hunted = true;
+            isSpeedBoostActive = true;
+            speedBoostTimer = 4.0f;
+        }
+    }
+
+    void eatFish(size_t i)
+    {
+        ++fishEaten;
+        orbitSpeedCount_ = SIZE_MAX;
+        if (!respawnEaten)
+        {
+            broadphase.onRemove(fishes, i);
+            fishes.removeAt(i);
+            return;
+        }
+
+        const glm::vec3 center(fishes.centerX[i], 0.0f, fishes.centerZ[i]);
+        const float orbitRadius = fishes.radius[i];
+        const float respawnAngle = fishes.angle[i] + glm::pi<float>();
+        const glm::vec3 position(center.x + orbitRadius * std::cos(respawnAngle), fishes.posY[i],
+                                 center.z + orbitRadius * std::sin(respawnAngle));
+        const glm::vec3 fishScale = fishes.scale[i];
+        const float fishAngularSpeed = fishes.angularSpeed[i];
+
+        broadphase.onRemove(fishes, i);
+        fishes.removeAt(i);
+        fishes.add(position, fishScale, center, fishAngularSpeed);
+        broadphase.onAdd(fishes.size() - 1);
+    }
+
+    void updateShark(float deltaTime)
+    {
+        // In hunting mode, the shark will get more speed
+        if (shark.hunting)
+        {
+            shark.speed = 1.0f;
+            shark.turnSpeed = 20.0f;
+        }
+        else {
+            shark.speed = 0.4f;
+            shark.turnSpeed = 10.0f;
+        }
+
+        // Update shark direction and position
+        glm::vec3 sharkDirection = glm::normalize(glm::vec3(
+            std::cos(glm::radians(shark.directionAngle)) * std::cos(glm::radians(shark.pitchAngle)),
+            glm::clamp(std::sin(glm::radians(shark.pitchAngle)), -0.5f, 0.5f),
+            std::sin(glm::radians(shark.directionAngle)) * std::cos(glm::radians(shark.pitchAngle))
+        ));
+
+        // In case that the shark goes below the land
+        if (shark.position.y < -1.0f)
+        {
+            shark.pitchAngle = glm::clamp(shark.pitchAngle + shark.verticalTurnSpeed * deltaTime, 0.0f, 30.0f);
+        }
+
+        shark.position += sharkDirection * shark.speed * deltaTime;
+
+        if (shark.position.y < -1.0f)
+        {
+            shark.position.y = -1.0f;
+        }
+
+        // Update shark bounding spheres
+        sharkBoundingSphere1.center = shark.position;
+        sharkBoundingSphere2.center = shark.position;
+    }
+
+    JobSystem& jobs_;
+    SimStats stats_;
+    float maxOrbitSpeed_ = 0.0f;
+    size_t orbitSpeedCount_ = SIZE_MAX;     // Fish count maxOrbitSpeed_ was computed for
+    float lastFishStep_ = 0.0f;
+
+};
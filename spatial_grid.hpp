@@ -0,0 +1,174 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Uniform spatial hash grid over point streams.
+//
+// build() buckets every point by a hash of its integer cell coordinates with
+// a counting sort: one pass to count, a prefix sum, one pass to scatter. After
+// that, the points of bucket b are sortedIndices[cellStart[b] .. cellStart[b + 1]).
+// Different cells can share a bucket, so queries must still test distances.
+class SpatialHashGrid
+{
+public:
+    std::vector<uint32_t> cellStart;      // tableSize + 1 offsets into sortedIndices
+    std::vector<uint32_t> sortedIndices;  // Point indices grouped by bucket
+
+    float cellSize() const { return cellSize_; }
+
+    void build(const float* x, const float* y, const float* z, size_t count, float cellSize)
+    {
+        cellSize_ = cellSize;
+        invCellSize_ = 1.0f / cellSize;
+
+        // Roughly two buckets per point keeps collisions rare
+        size_t tableSize = 64;
+        while (tableSize < count * 2)
+            tableSize <<= 1;
+        mask_ = static_cast<uint32_t>(tableSize - 1);
+
+        pointBucket_.resize(count);
+        cellStart.assign(tableSize + 1, 0);
+        sortedIndices.resize(count);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint32_t bucket = bucketOf(cellCoord(x[i]), cellCoord(y[i]), cellCoord(z[i]));
+            pointBucket_[i] = bucket;
+            ++cellStart[bucket + 1];
+        }
+
+        for (size_t b = 0; b < tableSize; ++b)
+            cellStart[b + 1] += cellStart[b];
+
+        // Scatter with a moving cursor per bucket; cellStart[b] ends up at the old cellStart[b + 1]
+        for (size_t i = 0; i < count; ++i)
+            sortedIndices[cellStart[pointBucket_[i]]++] = static_cast<uint32_t>(i);
+
+        for (size_t b = tableSize; b > 0; --b)
+            cellStart[b] = cellStart[b - 1];
+        cellStart[0] = 0;
+    }
+
+    static constexpr uint32_t kNoPoint = UINT32_MAX;
+
+    // Gives point `from` the index `to` without rebuilding, for stores that
+    // move elements around (swap and pop). With to == kNoPoint the entry stays
+    // in its bucket as a tombstone that callers must skip.
+    void relabel(size_t from, uint32_t to)
+    {
+        const uint32_t bucket = pointBucket_[from];
+        for (uint32_t k = cellStart[bucket]; k < cellStart[bucket + 1]; ++k)
+        {
+            if (sortedIndices[k] == from)
+            {
+                sortedIndices[k] = to;
+                if (to != kNoPoint)
+                {
+                    if (to >= pointBucket_.size())
+                        pointBucket_.resize(to + 1);
+                    pointBucket_[to] = bucket;
+                }
+                return;
+            }
+        }
+    }
+
+    int cellCoord(float v) const
+    {
+        return static_cast<int>(std::floor(v * invCellSize_));
+    }
+
+    // Morton (Z-order) code of the cell, wrapped to the table size. Nearby cells
+    // land in nearby buckets, so a neighbourhood query touches few cache lines;
+    // cells a whole table period apart share buckets and are told apart by the
+    // distance test.
+    uint32_t bucketOf(int cx, int cy, int cz) const
+    {
+        return (spreadBits(static_cast<uint32_t>(cx))
+             | (spreadBits(static_cast<uint32_t>(cy)) << 1)
+             | (spreadBits(static_cast<uint32_t>(cz)) << 2)) & mask_;
+    }
+
+    // Calls fn(first, last) with the sortedIndices range of every bucket that
+    // overlaps the box [center - radius, center + radius]. Each bucket is visited
+    // once even if several cells of the box hash to it. fn may return false to
+    // stop early; the return value says whether the walk ran to completion.
+    template <typename Fn>
+    bool forEachBucket(const glm::vec3& center, float radius, Fn&& fn) const
+    {
+        if (sortedIndices.empty())
+            return true;
+
+        const int x0 = cellCoord(center.x - radius), x1 = cellCoord(center.x + radius);
+        const int y0 = cellCoord(center.y - radius), y1 = cellCoord(center.y + radius);
+        const int z0 = cellCoord(center.z - radius), z1 = cellCoord(center.z + radius);
+
+        uint32_t visited[kMaxTrackedBuckets];
+        int visitedCount = 0;
+
+        for (int cx = x0; cx <= x1; ++cx)
+        for (int cy = y0; cy <= y1; ++cy)
+        for (int cz = z0; cz <= z1; ++cz)
+        {
+            const uint32_t bucket = bucketOf(cx, cy, cz);
+            const uint32_t first = cellStart[bucket];
+            const uint32_t last = cellStart[bucket + 1];
+            if (first == last) continue;
+
+            bool seen = false;
+            for (int v = 0; v < visitedCount; ++v)
+            {
+                if (visited[v] == bucket) { seen = true; break; }
+            }
+            if (seen) continue;
+            if (visitedCount < kMaxTrackedBuckets)
+                visited[visitedCount++] = bucket;
+
+            if (!fn(first, last))
+                return false;
+        }
+        return true;
+    }
+
+    // Same walk as forEachBucket, calling fn(index) per point
+    template <typename Fn>
+    bool forEachCandidate(const glm::vec3& center, float radius, Fn&& fn) const
+    {
+        return forEachBucket(center, radius, [&](uint32_t first, uint32_t last)
+        {
+            for (uint32_t k = first; k < last; ++k)
+            {
+                if (!fn(static_cast<size_t>(sortedIndices[k])))
+                    return false;
+            }
+            return true;
+        });
+    }
+
+private:
+    // Spreads the low 10 bits of v so there are two zero bits between each
+    static uint32_t spreadBits(uint32_t v)
+    {
+        v &= 0x000003ffu;
+        v = (v | (v << 16)) & 0x030000ffu;
+        v = (v | (v << 8)) & 0x0300f00fu;
+        v = (v | (v << 4)) & 0x030c30c3u;
+        v = (v | (v << 2)) & 0x09249249u;
+        return v;
+    }
+
+    // Enough for a 3x3x3 neighbourhood plus slack. Boxes spanning more cells may
+    // revisit a bucket once this fills up and so report a point twice
+    static constexpr int kMaxTrackedBuckets = 64;
+
+    float cellSize_ = 1.0f;
+    float invCellSize_ = 1.0f;
+    uint32_t mask_ = 0;
+    std::vector<uint32_t> pointBucket_;
+};
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "gl_state.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+// Ring buffer for data written by the CPU every frame (instance attributes,
+// uniform blocks, debug geometry).
+//
+// The buffer is split into kFrames regions, one per frame in flight. A frame
+// only writes into its own region, mapped with GL_MAP_UNSYNCHRONIZED_BIT so the
+// driver never stalls on its implicit sync; instead endFrame() drops a fence
+// behind the frame's draws and beginFrame() waits on that fence before the
+// region is reused, kFrames frames later.
+//
+// A frame that outgrows its region gets its extra allocations from one-off
+// buffers, and the next beginFrame() grows the ring to fit, so allocations are
+// never moved once handed out.
+//
+//   streaming.beginFrame();
+//   StreamingBuffer::Allocation a = streaming.map(bytes);  // write to a.data
+//   streaming.unmap();                                       // draw from a.buffer at a.offset
+//   ...
+//   streaming.endFrame();                                    // after the frame's draws
+class StreamingBuffer
+{
+public:
+    static constexpr int kFrames = 3;
+
+    struct Allocation
+    {
+        void* data = nullptr;       // Mapped memory, valid until unmap()
+        GLuint buffer = 0;          // The ring, or a one-off buffer after an overflow
+        GLintptr offset = 0;        // Byte offset into buffer
+        GLsizeiptr size = 0;
+    };
+
+    struct Stats
+    {
+        uint64_t bytesUploaded = 0;
+        uint64_t allocations = 0;
+        uint64_t fenceWaits = 0;    // beginFrame() calls that had to block on the GPU
+        double fenceWaitMs = 0.0;
+        uint64_t overflows = 0;     // Allocations that did not fit their frame's region
+        uint64_t reallocations = 0; // Times the ring was grown after an overflow
+    };
+
+    explicit StreamingBuffer(size_t bytesPerFrame = 4 << 20)
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        uniformAlignment_ = static_cast<size_t>(std::max(alignment, 16));
+
+        glGenBuffers(1, &buffer_);
+        allocate(bytesPerFrame);
+    }
+
+    ~StreamingBuffer()
+    {
+        for (int region = 0; region < kFrames; ++region)
+        {
+            if (fences_[region])
+                glDeleteSync(fences_[region]);
+            releaseOverflow(region);
+        }
+        GlState::current().forgetBuffer(buffer_);
+        glDeleteBuffers(1, &buffer_);
+    }
+
+    StreamingBuffer(const StreamingBuffer&) = delete;
+    StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+
+    GLuint buffer() const { return buffer_; }
+    size_t regionSize() const { return regionSize_; }
+    size_t uniformAlignment() const { return uniformAlignment_; }
+    const Stats& stats() const { return stats_; }
+
+    // Moves to the next region, waiting until the GPU is done with it
+    void beginFrame()
+    {
+        // Nothing of the new frame has been handed out yet, so this is the one
+        // point where the ring can be reallocated
+        if (needed_ > regionSize_)
+        {
+            for (int region = 0; region < kFrames; ++region)
+                waitFor(region);
+            size_t size = regionSize_;
+            while (size < needed_)
+                size *= 2;
+            allocate(size);
+            ++stats_.reallocations;
+        }
+
+        frame_ = (frame_ + 1) % kFrames;
+        head_ = 0;
+        needed_ = 0;
+        waitFor(frame_);
+    }
+
+    // Fences the region written this frame; call after its last draw
+    void endFrame()
+    {
+        if (fences_[frame_])
+            glDeleteSync(fences_[frame_]);
+        fences_[frame_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // Maps bytes of this frame's region for writing. Only one mapping may be
+    // open at a time; close it with unmap() before drawing from it.
+    Allocation map(size_t bytes, size_t alignment = 16)
+    {
+        const size_t offset = alignUp(head_, alignment);
+        head_ = offset + bytes;
+        needed_ = std::max(needed_, head_);
+
+        Allocation allocation;
+        allocation.size = static_cast<GLsizeiptr>(bytes);
+        stats_.bytesUploaded += bytes;
+        ++stats_.allocations;
+        if (bytes == 0)
+            return allocation;
+
+        if (head_ <= regionSize_)
+        {
+            allocation.buffer = buffer_;
+            allocation.offset = static_cast<GLintptr>(frame_ * regionSize_ + offset);
+            GlState::current().bindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+            allocation.data = glMapBufferRange(GL_COPY_WRITE_BUFFER, allocation.offset, allocation.size,
+                                               GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        }
+        else
+        {
+            // Lives until this region's fence has passed
+            ++stats_.overflows;
+            glGenBuffers(1, &allocation.buffer);
+            overflow_[frame_].push_back(allocation.buffer);
+            GlState::current().bindBuffer(GL_COPY_WRITE_BUFFER, allocation.buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, allocation.size, nullptr, GL_STREAM_DRAW);
+            allocation.data = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, allocation.size,
+                                               GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        }
+        mapped_ = allocation.buffer;
+        return allocation;
+    }
+
+    void unmap()
+    {
+        if (!mapped_)
+            return;
+        GlState::current().bindBuffer(GL_COPY_WRITE_BUFFER, mapped_);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        mapped_ = 0;
+    }
+
+    // Copies data into this frame's region and returns where it landed
+    Allocation upload(const void* data, size_t bytes, size_t alignment = 16)
+    {
+        Allocation allocation = map(bytes, alignment);
+        if (allocation.data)
+            std::memcpy(allocation.data, data, bytes);
+        unmap();
+        allocation.data = nullptr;
+        return allocation;
+    }
+
+    // Uploads a uniform block and binds it to the given binding point
+    void uploadUniformBlock(GLuint binding, const void* data, size_t bytes)
+    {
+        const Allocation allocation = upload(data, bytes, uniformAlignment_);
+        GlState::current().bindUniformBufferRange(binding, allocation.buffer, allocation.offset, allocation.size);
+    }
+
+    void printStats(std::ostream& out) const
+    {
+        out << "Streaming buffer: " << kFrames << " x " << regionSize_ / 1024 << " KiB, "
+            << std::fixed << std::setprecision(2)
+            << static_cast<double>(stats_.bytesUploaded) / (1024.0 * 1024.0) << " MiB uploaded in "
+            << stats_.allocations << " allocations, " << stats_.fenceWaits << " fence waits ("
+            << stats_.fenceWaitMs << " ms), " << stats_.overflows << " overflows, "
+            << stats_.reallocations << " reallocations"
+            << std::defaultfloat << std::endl;
+    }
+
+private:
+    static size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    void waitFor(int region)
+    {
+        GLsync fence = fences_[region];
+        if (!fence)
+            return;
+
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            ++stats_.fenceWaits;
+            const auto start = std::chrono::steady_clock::now();
+            do
+            {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+            } while (result == GL_TIMEOUT_EXPIRED);
+            stats_.fenceWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        glDeleteSync(fence);
+        fences_[region] = nullptr;
+        releaseOverflow(region);
+    }
+
+    void releaseOverflow(int region)
+    {
+        for (GLuint buffer : overflow_[region])
+            GlState::current().forgetBuffer(buffer);
+        if (!overflow_[region].empty())
+            glDeleteBuffers(static_cast<GLsizei>(overflow_[region].size()), overflow_[region].data());
+        overflow_[region].clear();
+    }
+
+    void allocate(size_t bytesPerFrame)
+    {
+        regionSize_ = alignUp(std::max<size_t>(bytesPerFrame, 1), uniformAlignment_);
+        GlState::current().bindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(regionSize_ * kFrames), nullptr, GL_STREAM_DRAW);
+    }
+
+    GLuint buffer_ = 0;
+    size_t regionSize_ = 0;
+    size_t uniformAlignment_ = 256;
+    size_t head_ = 0;               // Bytes used in the current region
+    size_t needed_ = 0;             // Bytes the current frame asked for, overflow included
+    int frame_ = 0;
+    GLuint mapped_ = 0;             // Buffer with an open mapping
+    GLsync fences_[kFrames] = {};
+    std::vector<GLuint> overflow_[kFrames];
+    Stats stats_;
+};
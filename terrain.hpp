@@ -0,0 +1,183 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm.hpp>
+
+#include "culling.hpp"
+#include "gl_state.hpp"
+#include "model.hpp"
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Static terrain split into a grid of square chunks on the XZ plane, so the
+// parts outside the frustum or lost in the fog are never submitted.
+//
+// Chunking happens once at load: each mesh's triangles are bucketed by the
+// chunk their centroid falls in and the index buffer is rewritten so every
+// chunk is one contiguous index range. Vertices stay where they are, so a chunk
+// is a single glDrawElements on the mesh's own VAO. Larger seabeds only add
+// chunks; the per-frame cost follows what is visible, not the total size.
+//
+//   ChunkedTerrain terrain(landModel, terrainModel, 10.0f);
+//   terrain.cull(frustum, camera.position(), fogDistance, visibleChunks);
+//   terrain.submit(queue, visibleChunks, camera.position(), modelShader.ID, texture, object);
+class ChunkedTerrain
+{
+public:
+    struct Chunk
+    {
+        unsigned mesh;              // Index into Model::meshes
+        size_t firstIndex;          // Into the mesh's (reordered) index buffer
+        size_t indexCount;
+        glm::vec3 boundsMin;        // World space
+        glm::vec3 boundsMax;
+    };
+
+    // transform places the model in the world; chunkSize is in world units
+    ChunkedTerrain(Model& model, const glm::mat4& transform, float chunkSize)
+        : model_(model)
+    {
+        for (unsigned m = 0; m < model.meshes.size(); ++m)
+            split(m, transform, chunkSize);
+    }
+
+    ChunkedTerrain(const ChunkedTerrain&) = delete;
+    ChunkedTerrain& operator=(const ChunkedTerrain&) = delete;
+
+    const std::vector<Chunk>& chunks() const { return chunks_; }
+    const Culling::BoxList& bounds() const { return bounds_; }
+
+    // Replaces visible with the chunks inside the frustum and closer to eye
+    // than maxDistance (e.g. where the fog becomes opaque)
+    Culling::CullStats cull(const Culling::Frustum& frustum, const glm::vec3& eye, float maxDistance,
+                            std::vector<uint32_t>& visible) const
+    {
+        Culling::CullStats stats = Culling::cullBoxes(frustum, bounds_.view(), visible);
+
+        const float maxDistance2 = maxDistance * maxDistance;
+        size_t kept = 0;
+        for (uint32_t c : visible)
+        {
+            const glm::vec3 nearest = glm::clamp(eye, chunks_[c].boundsMin, chunks_[c].boundsMax);
+            const glm::vec3 offset = nearest - eye;
+            if (glm::dot(offset, offset) <= maxDistance2)
+                visible[kept++] = c;
+        }
+        visible.resize(kept);
+        stats.visible = kept;
+        return stats;
+    }
+
+    // Every chunk, in order (for drawing without culling)
+    void all(std::vector<uint32_t>& visible) const
+    {
+        visible.resize(chunks_.size());
+        for (size_t c = 0; c < visible.size(); ++c)
+            visible[c] = static_cast<uint32_t>(c);
+    }
+
+    // Queues one glDrawElements per listed chunk, at the distance from eye
+    // to the chunk's nearest point, so the queue draws them front to back
+    void submit(RenderQueue& queue, const std::vector<uint32_t>& visible, const glm::vec3& eye,
+                GLuint program, GLuint texture, uint32_t object) const
+    {
+        for (uint32_t c : visible)
+        {
+            const Chunk& chunk = chunks_[c];
+            RenderQueue::DrawItem item;
+            item.program = program;
+            item.textures[0] = texture;
+            item.vao = model_.meshes[chunk.mesh].VAO;
+            item.count = static_cast<GLsizei>(chunk.indexCount);
+            item.first = chunk.firstIndex;
+            item.object = object;
+            queue.submit(RenderQueue::kOpaque, item, glm::length(glm::clamp(eye, chunk.boundsMin, chunk.boundsMax) - eye));
+        }
+    }
+
+private:
+    void split(unsigned m, const glm::mat4& transform, float chunkSize)
+    {
+        Mesh& mesh = model_.meshes[m];
+        const size_t triangleCount = mesh.indices.size() / 3;
+        if (triangleCount == 0)
+            return;
+
+        std::vector<glm::vec3> world(mesh.vertices.size());
+        glm::vec2 gridMin(std::numeric_limits<float>::max());
+        glm::vec2 gridMax(-std::numeric_limits<float>::max());
+        for (size_t v = 0; v < world.size(); ++v)
+        {
+            world[v] = glm::vec3(transform * glm::vec4(mesh.vertices[v].Position, 1.0f));
+            gridMin = glm::min(gridMin, glm::vec2(world[v].x, world[v].z));
+            gridMax = glm::max(gridMax, glm::vec2(world[v].x, world[v].z));
+        }
+
+        const int columns = std::max(1, static_cast<int>(std::ceil((gridMax.x - gridMin.x) / chunkSize)));
+        const int rows = std::max(1, static_cast<int>(std::ceil((gridMax.y - gridMin.y) / chunkSize)));
+
+        // Chunk of each triangle, by centroid
+        std::vector<uint32_t> cellOf(triangleCount);
+        std::vector<size_t> cellStart(static_cast<size_t>(columns) * rows + 1, 0);
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            const glm::vec3 centroid = (world[mesh.indices[3 * t]] + world[mesh.indices[3 * t + 1]]
+                                        + world[mesh.indices[3 * t + 2]]) / 3.0f;
+            const int column = glm::clamp(static_cast<int>((centroid.x - gridMin.x) / chunkSize), 0, columns - 1);
+            const int row = glm::clamp(static_cast<int>((centroid.z - gridMin.y) / chunkSize), 0, rows - 1);
+            cellOf[t] = static_cast<uint32_t>(row * columns + column);
+            ++cellStart[cellOf[t] + 1];
+        }
+        for (size_t cell = 1; cell < cellStart.size(); ++cell)
+            cellStart[cell] += cellStart[cell - 1];
+
+        // Counting sort keeps the original triangle order within a chunk
+        std::vector<unsigned int> sorted(mesh.indices.size());
+        std::vector<size_t> cursor(cellStart.begin(), cellStart.end() - 1);
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            const size_t slot = cursor[cellOf[t]]++;
+            sorted[3 * slot] = mesh.indices[3 * t];
+            sorted[3 * slot + 1] = mesh.indices[3 * t + 1];
+            sorted[3 * slot + 2] = mesh.indices[3 * t + 2];
+        }
+        mesh.indices.swap(sorted);
+
+        // The element buffer binding is VAO state, so this updates the mesh's own EBO
+        GlState::current().bindVertexArray(mesh.VAO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data());
+
+        for (size_t cell = 0; cell + 1 < cellStart.size(); ++cell)
+        {
+            const size_t first = cellStart[cell];
+            const size_t count = cellStart[cell + 1] - first;
+            if (count == 0)
+                continue;
+
+            Chunk chunk;
+            chunk.mesh = m;
+            chunk.firstIndex = 3 * first;
+            chunk.indexCount = 3 * count;
+            chunk.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+            chunk.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+            for (size_t i = chunk.firstIndex; i < chunk.firstIndex + chunk.indexCount; ++i)
+            {
+                chunk.boundsMin = glm::min(chunk.boundsMin, world[mesh.indices[i]]);
+                chunk.boundsMax = glm::max(chunk.boundsMax, world[mesh.indices[i]]);
+            }
+            chunks_.push_back(chunk);
+            bounds_.add(chunk.boundsMin, chunk.boundsMax);
+        }
+    }
+
+    Model& model_;
+    std::vector<Chunk> chunks_;
+    Culling::BoxList bounds_;
+};
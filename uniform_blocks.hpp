@@ -0,0 +1,158 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm.hpp>
+
+#include "gl_state.hpp"
+#include "shader.hpp"
+#include "streaming_buffer.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// C++ mirrors of the std140 uniform blocks declared in the shaders.
+//
+// FrameConstants holds everything that is the same for every draw of a frame
+// and is uploaded once per frame; ObjectConstants holds what changes per draw.
+// Both live in the frame's StreamingBuffer region and are attached to fixed
+// binding points, which every program is pointed at once after linking
+// (GLSL 3.30 has no layout(binding)).
+//
+// std140 puts a vec3 on a 16-byte boundary but lets a scalar fill the rest of
+// its slot, so each vec3 below is paired with a float; the static_asserts keep
+// the offsets in step with the GLSL declarations.
+namespace UniformBlocks
+{
+    static constexpr GLuint kFrameBinding = 0;
+    static constexpr GLuint kObjectBinding = 1;
+
+    // layout(std140) uniform FrameConstants in every shader under shader/
+    struct FrameConstants
+    {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec3 viewPos;          // Camera position
+        float time;                 // Seconds since start
+        glm::vec3 ambientLight;
+        float fogDensity;
+        glm::vec3 lightColor;
+        float padding0;
+        glm::vec3 lightDir;         // Directional light
+        float padding1;
+        glm::vec3 fogColor;
+        float padding2;
+    };
+
+    static_assert(offsetof(FrameConstants, view) == 64, "FrameConstants must match std140");
+    static_assert(offsetof(FrameConstants, viewPos) == 128, "FrameConstants must match std140");
+    static_assert(offsetof(FrameConstants, time) == 140, "FrameConstants must match std140");
+    static_assert(offsetof(FrameConstants, ambientLight) == 144, "FrameConstants must match std140");
+    static_assert(offsetof(FrameConstants, fogDensity) == 156, "FrameConstants must match std140");
+    static_assert(offsetof(FrameConstants, lightColor) == 160, "FrameConstants must match std140");
+    static_assert(offsetof(FrameConstants, lightDir) == 176, "FrameConstants must match std140");
+    static_assert(offsetof(FrameConstants, fogColor) == 192, "FrameConstants must match std140");
+    static_assert(sizeof(FrameConstants) == 208, "FrameConstants must match std140");
+
+    // layout(std140) uniform ObjectConstants
+    struct ObjectConstants
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        int isShark = 0;            // bool in GLSL terms; std140 bools are 4 bytes
+        int meshID = 0;             // Shark submesh (body, eyes, teeth)
+        float impostorFadeStart = 0.0f;     // Fish crossfade band; 0, 0 = no fade
+        float impostorFadeEnd = 0.0f;
+        float swayMultiplier = 1.5f;        // Shark sway strength
+        float padding0;
+        float padding1;
+        float padding2;
+    };
+
+    static_assert(offsetof(ObjectConstants, isShark) == 64, "ObjectConstants must match std140");
+    static_assert(offsetof(ObjectConstants, meshID) == 68, "ObjectConstants must match std140");
+    static_assert(offsetof(ObjectConstants, impostorFadeStart) == 72, "ObjectConstants must match std140");
+    static_assert(offsetof(ObjectConstants, impostorFadeEnd) == 76, "ObjectConstants must match std140");
+    static_assert(offsetof(ObjectConstants, swayMultiplier) == 80, "ObjectConstants must match std140");
+    static_assert(sizeof(ObjectConstants) == 96, "ObjectConstants must match std140");
+
+    // Points a block, if the program declares it, at binding; a block larger
+    // than the C++ struct means the two declarations have drifted apart
+    inline void bindBlock(const Shader& shader, const char* name, GLuint binding, size_t size)
+    {
+        const Shader::BlockInfo* block = shader.findBlock(name);
+        if (!block)
+            return;
+        if (static_cast<size_t>(block->dataSize) > size)
+            shader.reportError(std::string("UNIFORM_BLOCK_SIZE_MISMATCH: ") + name + " is "
+                               + std::to_string(block->dataSize) + " bytes in GLSL, " + std::to_string(size) + " in C++");
+        glUniformBlockBinding(shader.ID, block->index, binding);
+    }
+
+    // Points the program's blocks (those it declares) at the fixed binding points
+    inline void bind(const Shader& shader)
+    {
+        bindBlock(shader, "FrameConstants", kFrameBinding, sizeof(FrameConstants));
+        bindBlock(shader, "ObjectConstants", kObjectBinding, sizeof(ObjectConstants));
+    }
+
+    inline void upload(StreamingBuffer& streaming, const FrameConstants& constants)
+    {
+        streaming.uploadUniformBlock(kFrameBinding, &constants, sizeof(constants));
+    }
+
+    inline void upload(StreamingBuffer& streaming, const ObjectConstants& constants)
+    {
+        streaming.uploadUniformBlock(kObjectBinding, &constants, sizeof(constants));
+    }
+
+    // ObjectConstants for a run of draws, written with one mapping:
+    //
+    //   ObjectConstantsArray objects(streaming, count);
+    //   for (i) objects.set(i, constants);
+    //   for (i) { objects.bind(i); draw(i); }
+    class ObjectConstantsArray
+    {
+    public:
+        ObjectConstantsArray(StreamingBuffer& streaming, size_t count)
+            : streaming_(streaming),
+              stride_((sizeof(ObjectConstants) + streaming.uniformAlignment() - 1) / streaming.uniformAlignment()
+                      * streaming.uniformAlignment())
+        {
+            allocation_ = streaming.map(count * stride_, streaming.uniformAlignment());
+        }
+
+        ~ObjectConstantsArray()
+        {
+            if (allocation_.data)
+                streaming_.unmap();
+        }
+
+        ObjectConstantsArray(const ObjectConstantsArray&) = delete;
+        ObjectConstantsArray& operator=(const ObjectConstantsArray&) = delete;
+
+        void set(size_t i, const ObjectConstants& constants)
+        {
+            if (allocation_.data)
+                std::memcpy(static_cast<char*>(allocation_.data) + i * stride_, &constants, sizeof(constants));
+        }
+
+        // Closes the mapping on first use; set() must not be called after
+        void bind(size_t i)
+        {
+            if (allocation_.data)
+            {
+                streaming_.unmap();
+                allocation_.data = nullptr;
+            }
+            GlState::current().bindUniformBufferRange(kObjectBinding, allocation_.buffer,
+                                                      allocation_.offset + static_cast<GLintptr>(i * stride_),
+                                                      sizeof(ObjectConstants));
+        }
+
+    private:
+        StreamingBuffer& streaming_;
+        size_t stride_;
+        StreamingBuffer::Allocation allocation_;
+    };
+}
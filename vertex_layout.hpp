@@ -0,0 +1,217 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Vertex formats declared as types. A format lists its attributes in buffer
+// order; stride and offsets are computed at compile time, and the same type
+// emits the VAO setup and describes itself to Shader::checkVertexInputs():
+//
+//   using Format = VertexLayout::Format<
+//       VertexLayout::Attribute<0, float, 3>,                                   // vec3 position
+//       VertexLayout::Attribute<1, VertexLayout::Int2101010, 4, VertexLayout::kNormalized>,
+//       VertexLayout::Attribute<3, uint8_t, 1, VertexLayout::kInteger>,         // int in GLSL
+//       VertexLayout::Padding<3>>;
+//   static_assert(Format::stride == sizeof(MyVertex), "");
+//   static_assert(Format::offsetOf(1) == offsetof(MyVertex, normal), "");
+//
+//   Format::setup();                                   // VAO and GL_ARRAY_BUFFER bound
+//   shader.checkVertexInputs({ Format::info() }, "my mesh");
+namespace VertexLayout
+{
+    // How the shader sees the components
+    enum Fetch
+    {
+        kFloat,         // Converted to float as they are
+        kNormalized,    // Integers mapped to [0, 1] or [-1, 1]
+        kInteger        // Integers read by int / uint / ivecN inputs (glVertexAttribIPointer)
+    };
+
+    // Component types without a C++ equivalent
+    struct Half {};             // GL_HALF_FLOAT
+    struct Int2101010 {};       // GL_INT_2_10_10_10_REV, all four components in one 32-bit word
+
+    template <typename T>
+    struct Component;
+
+    template <> struct Component<float>      { static constexpr GLenum type = GL_FLOAT;          static constexpr size_t size(int count) { return 4 * count; } };
+    template <> struct Component<int8_t>     { static constexpr GLenum type = GL_BYTE;           static constexpr size_t size(int count) { return count; } };
+    template <> struct Component<uint8_t>    { static constexpr GLenum type = GL_UNSIGNED_BYTE;  static constexpr size_t size(int count) { return count; } };
+    template <> struct Component<int16_t>    { static constexpr GLenum type = GL_SHORT;          static constexpr size_t size(int count) { return 2 * count; } };
+    template <> struct Component<uint16_t>   { static constexpr GLenum type = GL_UNSIGNED_SHORT; static constexpr size_t size(int count) { return 2 * count; } };
+    template <> struct Component<int32_t>    { static constexpr GLenum type = GL_INT;            static constexpr size_t size(int count) { return 4 * count; } };
+    template <> struct Component<uint32_t>   { static constexpr GLenum type = GL_UNSIGNED_INT;   static constexpr size_t size(int count) { return 4 * count; } };
+    template <> struct Component<Half>       { static constexpr GLenum type = GL_HALF_FLOAT;     static constexpr size_t size(int count) { return 2 * count; } };
+    template <> struct Component<Int2101010> { static constexpr GLenum type = GL_INT_2_10_10_10_REV; static constexpr size_t size(int) { return 4; } };
+
+    // Runtime description of one attribute, for GL calls and reflection checks
+    struct AttributeInfo
+    {
+        GLuint location;
+        GLint count;
+        GLenum type;
+        Fetch fetch;
+        size_t offset;
+    };
+
+    // Runtime description of a whole format
+    struct FormatInfo
+    {
+        const AttributeInfo* attributes;
+        size_t count;
+        GLsizei stride;
+    };
+
+    template <GLuint Location, typename ComponentType, int Count, Fetch Mode = kFloat>
+    struct Attribute
+    {
+        static_assert(Count >= 1 && Count <= 4, "An attribute has one to four components");
+        static_assert(Mode != kInteger || (Component<ComponentType>::type != GL_FLOAT && Component<ComponentType>::type != GL_HALF_FLOAT
+                                           && Component<ComponentType>::type != GL_INT_2_10_10_10_REV),
+                      "Only plain integer components can be read as integers");
+        static_assert(Component<ComponentType>::type != GL_INT_2_10_10_10_REV || Count == 4,
+                      "GL_INT_2_10_10_10_REV always has four components");
+
+        static constexpr bool padding = false;
+        static constexpr GLuint location = Location;
+        static constexpr GLint count = Count;
+        static constexpr GLenum type = Component<ComponentType>::type;
+        static constexpr Fetch fetch = Mode;
+        static constexpr size_t size = Component<ComponentType>::size(Count);
+    };
+
+    // Bytes no attribute reads, e.g. to keep the next attribute 4-byte aligned
+    template <size_t Bytes>
+    struct Padding
+    {
+        static constexpr bool padding = true;
+        static constexpr GLuint location = 0;
+        static constexpr GLint count = 0;
+        static constexpr GLenum type = GL_NONE;
+        static constexpr Fetch fetch = kFloat;
+        static constexpr size_t size = Bytes;
+    };
+
+    namespace Detail
+    {
+        // Bytes before the index-th entry of the list
+        template <typename... Attributes>
+        constexpr size_t offsetOfIndex(size_t index)
+        {
+            const size_t sizes[] = { Attributes::size..., 0 };
+            size_t offset = 0;
+            for (size_t i = 0; i < index; ++i)
+                offset += sizes[i];
+            return offset;
+        }
+
+        // Bytes before the attribute at location, or SIZE_MAX if there is none
+        template <typename... Attributes>
+        constexpr size_t offsetOfLocation(GLuint location)
+        {
+            const bool padding[] = { Attributes::padding..., true };
+            const GLuint locations[] = { Attributes::location..., 0 };
+            for (size_t i = 0; i < sizeof...(Attributes); ++i)
+            {
+                if (!padding[i] && locations[i] == location)
+                    return offsetOfIndex<Attributes...>(i);
+            }
+            return SIZE_MAX;
+        }
+
+        // Every location at most once
+        template <typename... Attributes>
+        constexpr bool uniqueLocations()
+        {
+            const bool padding[] = { Attributes::padding..., true };
+            const GLuint locations[] = { Attributes::location..., 0 };
+            for (size_t i = 0; i < sizeof...(Attributes); ++i)
+            {
+                for (size_t j = i + 1; j < sizeof...(Attributes); ++j)
+                {
+                    if (!padding[i] && !padding[j] && locations[i] == locations[j])
+                        return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    template <typename... Attributes>
+    class Format
+    {
+    public:
+        static_assert(Detail::uniqueLocations<Attributes...>(), "Two attributes of a format share a location");
+
+        static constexpr GLsizei stride = static_cast<GLsizei>(Detail::offsetOfIndex<Attributes...>(sizeof...(Attributes)));
+
+        // Offset of the attribute at location within a vertex
+        static constexpr size_t offsetOf(GLuint location)
+        {
+            return Detail::offsetOfLocation<Attributes...>(location);
+        }
+
+        static const FormatInfo& info()
+        {
+            static const std::vector<AttributeInfo> attributes = collect();
+            static const FormatInfo format = { attributes.data(), attributes.size(), stride };
+            return format;
+        }
+
+        // Enables the attribute arrays of the bound VAO; divisor 1 for per-instance data
+        static void enable(GLuint divisor = 0)
+        {
+            const FormatInfo& format = info();
+            for (size_t i = 0; i < format.count; ++i)
+            {
+                glEnableVertexAttribArray(format.attributes[i].location);
+                glVertexAttribDivisor(format.attributes[i].location, divisor);
+            }
+        }
+
+        // Points the bound VAO's attributes at vertices starting at base in the
+        // bound GL_ARRAY_BUFFER
+        static void point(GLintptr base = 0)
+        {
+            const FormatInfo& format = info();
+            for (size_t i = 0; i < format.count; ++i)
+            {
+                const AttributeInfo& attribute = format.attributes[i];
+                const void* offset = (void*)(base + static_cast<GLintptr>(attribute.offset));
+                if (attribute.fetch == kInteger)
+                    glVertexAttribIPointer(attribute.location, attribute.count, attribute.type, stride, offset);
+                else
+                    glVertexAttribPointer(attribute.location, attribute.count, attribute.type,
+                                          attribute.fetch == kNormalized ? GL_TRUE : GL_FALSE, stride, offset);
+            }
+        }
+
+        static void setup(GLintptr base = 0, GLuint divisor = 0)
+        {
+            enable(divisor);
+            point(base);
+        }
+
+    private:
+        static std::vector<AttributeInfo> collect()
+        {
+            const AttributeInfo all[] = { { Attributes::location, Attributes::count, Attributes::type, Attributes::fetch, 0 }..., {} };
+            const bool padding[] = { Attributes::padding..., true };
+            std::vector<AttributeInfo> attributes;
+            for (size_t i = 0; i < sizeof...(Attributes); ++i)
+            {
+                if (padding[i])
+                    continue;
+                attributes.push_back(all[i]);
+                attributes.back().offset = Detail::offsetOfIndex<Attributes...>(i);
+            }
+            return attributes;
+        }
+    };
+
+    template <typename... Attributes>
+    constexpr GLsizei Format<Attributes...>::stride;
+}